@@ -0,0 +1,246 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// g++ $CXXFLAGS -std=c++17 analyze.cpp -o analyze
+
+/*
+ * Analysis of the sampled corpus.
+ *
+ * Writes, for the chips in chips.h:
+ * - wave0<n>.csv, the samples of waveform n with a column per chip;
+ * - rms.csv, the RMS of the samples of each chip and waveform;
+ * - distance0<n>.csv, the matrix of the audible error between
+ *   the samples of each pair of chips for waveform n.
+ *
+ * The corpus is loaded once and each file is written by a separate
+ * thread, one line at a time.
+ */
+
+#include "chips.h"
+#include "corpus.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static const int WAVES[] = { 3, 5, 6, 7 };
+
+/**
+ * Append the decimal representation of an unsigned value.
+ */
+static void Append(std::string &line, unsigned int value)
+{
+    char digits[10];
+    int n = 0;
+    do
+    {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    while (n)
+        line += digits[--n];
+}
+
+/**
+ * Write the samples of a waveform, a row with the chip names
+ * and then a row for each value, every field followed by a comma.
+ */
+static bool WriteSamples(const Corpus &corpus, const std::vector<int> &index, int wave, const char* file)
+{
+    std::ofstream ofs(file);
+    if (!ofs.is_open())
+        return false;
+
+    std::string line;
+    for (unsigned int i = 0; i < index.size(); i++)
+        line.append(chips[i]).append(",");
+    ofs << line << '\n';
+
+    std::vector<const uint8_t*> samples;
+    for (int chip: index)
+        samples.push_back(corpus.Get(chip, wave));
+
+    for (unsigned int j = 0; j < Corpus::SAMPLES; j++)
+    {
+        line.clear();
+        for (const uint8_t* s: samples)
+        {
+            Append(line, s[j]);
+            line += ',';
+        }
+        line += '\n';
+        ofs.write(line.data(), line.size());
+    }
+    return static_cast<bool>(ofs);
+}
+
+/**
+ * Write the RMS of the samples, a row for each chip
+ * with a column for each waveform.
+ */
+static bool WriteRms(const Corpus &corpus, const std::vector<int> &index, const char* file)
+{
+    std::ofstream ofs(file);
+    if (!ofs.is_open())
+        return false;
+
+    for (unsigned int i = 0; i < index.size(); i++)
+    {
+        ofs << chips[i];
+        for (int wave: WAVES)
+        {
+            const uint8_t* reference = corpus.Get(index[i], wave);
+            double sum = 0.;
+            for (unsigned int j = 0; j < Corpus::SAMPLES; j++)
+            {
+                const unsigned int val = reference[j];
+                sum += val * val;
+            }
+            ofs << "," << std::sqrt(sum/4096.0);
+        }
+        ofs << '\n';
+    }
+    return static_cast<bool>(ofs);
+}
+
+/**
+ * Write the distance matrix of a waveform, with the chip names
+ * in the first row and column.
+ */
+static bool WriteDistances(const Corpus &corpus, const std::vector<int> &index, int wave, const char* file)
+{
+    std::ofstream ofs(file);
+    if (!ofs.is_open())
+        return false;
+
+    std::string line;
+    for (unsigned int i = 0; i < index.size(); i++)
+        line.append(",").append(chips[i]);
+    ofs << line << '\n';
+
+    for (unsigned int i = 0; i < index.size(); i++)
+    {
+        line.assign(chips[i]);
+        for (unsigned int k = 0; k < index.size(); k++)
+        {
+            line += ',';
+            Append(line, corpus.Distance(index[i], index[k], wave));
+        }
+        line += '\n';
+        ofs.write(line.data(), line.size());
+    }
+    return static_cast<bool>(ofs);
+}
+
+static void Usage(const char* name)
+{
+    std::cout << "Usage " << name << " [options]" << std::endl
+              << "Writes all the files unless some are selected" << std::endl
+              << "Options:" << std::endl
+              << "  --samples    the samples of each waveform in wave0<n>.csv" << std::endl
+              << "  --rms        the RMS of the samples in rms.csv" << std::endl
+              << "  --distances  the distances between chips in distance0<n>.csv" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, const char* argv[])
+{
+    bool samples = false;
+    bool rms = false;
+    bool distances = false;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--samples") == 0)
+            samples = true;
+        else if (strcmp(argv[arg], "--rms") == 0)
+            rms = true;
+        else if (strcmp(argv[arg], "--distances") == 0)
+            distances = true;
+        else
+            Usage(argv[0]);
+    }
+
+    if (!samples && !rms && !distances)
+        samples = rms = distances = true;
+
+    Corpus corpus;
+    if (!corpus.Open(std::vector<std::string>(std::begin(chips), std::end(chips))))
+        exit(EXIT_FAILURE);
+
+    // the corpus may hold more chips, in a different order
+    std::vector<int> index;
+    for (const char* chip: chips)
+        index.push_back(corpus.Find(chip));
+
+    struct task_t
+    {
+        std::string file;
+        std::function<bool(const char*)> write;
+    };
+
+    std::vector<task_t> tasks;
+    for (int wave: WAVES)
+    {
+        if (samples)
+        {
+            tasks.push_back({ "wave0" + std::to_string(wave) + ".csv",
+                [&corpus, &index, wave](const char* file) { return WriteSamples(corpus, index, wave, file); } });
+        }
+        if (distances)
+        {
+            tasks.push_back({ "distance0" + std::to_string(wave) + ".csv",
+                [&corpus, &index, wave](const char* file) { return WriteDistances(corpus, index, wave, file); } });
+        }
+    }
+    if (rms)
+    {
+        tasks.push_back({ "rms.csv",
+            [&corpus, &index](const char* file) { return WriteRms(corpus, index, file); } });
+    }
+
+    bool failed = false;
+    #pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < static_cast<int>(tasks.size()); t++)
+    {
+        const bool ok = tasks[t].write(tasks[t].file.c_str());
+        #pragma omp critical
+        {
+            if (ok)
+            {
+                std::cout << "Saved " << tasks[t].file << std::endl;
+            }
+            else
+            {
+                std::cout << "Error writing file " << tasks[t].file << std::endl;
+                failed = true;
+            }
+        }
+    }
+
+    if (failed)
+        exit(EXIT_FAILURE);
+}
@@ -0,0 +1,298 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// g++ $CXXFLAGS -std=c++17 bench.cpp -o bench
+
+/*
+ * Benchmark of the scoring kernel.
+ *
+ * Times Parameters::Score() for each waveform and distance function,
+ * on one thread and on all of them, scoring the full table or stopping
+ * early at the stored best score, against the sampled references,
+ * and then scoring all the distance functions at once.
+ * The candidates are small random perturbations of the stored parameters,
+ * as in the optimizer, generated with a fixed seed so runs are comparable.
+ * With --batch all the candidates are scored at once by the batch scorer,
+ * on the accelerator if available, always without the early exit.
+ */
+
+#include "parameters.h"
+#include "corpus.h"
+#include "offload.h"
+#include "store.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+
+static const unsigned int CANDIDATES = 256;
+
+/**
+ * Generate the candidates perturbing the given parameters.
+ */
+static std::vector<Parameters> GetCandidates(const Parameters &base, Distance_t distance)
+{
+    std::mt19937 prng(0);
+    std::normal_distribution<> dist(1.0, 0.005);
+
+    std::vector<Parameters> candidates(CANDIDATES, base);
+    for (Parameters &p: candidates)
+    {
+        p.distFunc = distance;
+        for (Param_t i = Param_t::THRESHOLD; i <= Param_t::DISTANCE2; i++)
+            p.SetValue(i, static_cast<float>(p.GetValue(i) * dist(prng)));
+    }
+    return candidates;
+}
+
+struct result_t
+{
+    double nsPerSample;
+    double candidatesPerSecond;
+    double averageSamples;
+};
+
+/**
+ * Score the candidates repeatedly for at least the given time.
+ *
+ * @param allDistances score each candidate with all the distance functions at once
+ * @param scorer if not null score the candidates with it, against the given chip
+ */
+static result_t Run(const std::vector<Parameters> &candidates, int wave, bool is8580,
+                    const ref_vector_t &reference, unsigned int bound, bool allDistances, double seconds,
+                    const BatchScorer *scorer, unsigned int chip)
+{
+    using clock = std::chrono::steady_clock;
+
+    unsigned long evaluations = 0;
+    unsigned long long samples = 0;
+    unsigned long long sink = 0;
+
+    const auto start = clock::now();
+    double elapsed;
+    do
+    {
+        if (scorer)
+        {
+            for (const score_t &score: scorer->Score(candidates, chip, wave))
+            {
+                samples += score.samples;
+                sink += score.audible_error;
+            }
+        }
+        else
+        {
+            for (const Parameters &p: candidates)
+            {
+                if (allDistances)
+                {
+                    score_t scores[DISTANCES];
+                    p.ScoreDistances(wave, is8580, reference, bound, nullptr, scores);
+                    for (const score_t &score: scores)
+                    {
+                        samples += score.samples;
+                        sink += score.audible_error;
+                    }
+                }
+                else
+                {
+                    const score_t score = p.Score(wave, is8580, reference, bound);
+                    samples += score.samples;
+                    sink += score.audible_error;
+                }
+            }
+        }
+        evaluations += candidates.size();
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    }
+    while (elapsed < seconds);
+
+    // keep the scores alive
+    if (sink == 1)
+        std::cout << std::endl;
+
+    result_t result;
+    result.nsPerSample = elapsed * 1e9 / samples;
+    result.candidatesPerSecond = evaluations / elapsed;
+    result.averageSamples = static_cast<double>(samples) / evaluations;
+    return result;
+}
+
+static void Usage(const char* name)
+{
+    std::cout << "Usage " << name << " [options] [<chip>]" << std::endl
+              << "Options:" << std::endl
+              << "  --time <seconds>  time spent on each case (default 0.5)" << std::endl
+              << "  --simd <kernel>   use the scalar, avx2 or avx512 kernel (default the best available)" << std::endl
+              << "  --engine <name>   score with the float or the fixed point model (default float)" << std::endl
+              << "  --batch           score all the candidates at once with the batch scorer" << std::endl
+              << "  --params <file>   the parameter store (default " << ParamStore::DEFAULT_FILE << ")" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, const char* argv[])
+{
+    double seconds = 0.5;
+    const char* paramsFile = ParamStore::DEFAULT_FILE;
+    bool batch = false;
+
+    int arg = 1;
+    for (; (arg < argc) && (argv[arg][0] == '-'); arg++)
+    {
+        if ((strcmp(argv[arg], "--time") == 0) && (arg + 1 < argc))
+        {
+            seconds = atof(argv[++arg]);
+        }
+        else if ((strcmp(argv[arg], "--simd") == 0) && (arg + 1 < argc))
+        {
+            const char* kernel = argv[++arg];
+            Mixer::simd_t simd;
+            if (strcmp(kernel, "scalar") == 0)
+                simd = Mixer::simd_t::SCALAR;
+            else if (strcmp(kernel, "avx2") == 0)
+                simd = Mixer::simd_t::AVX2;
+            else if (strcmp(kernel, "avx512") == 0)
+                simd = Mixer::simd_t::AVX512;
+            else
+                Usage(argv[0]);
+            Mixer::UseSimd(simd);
+            FixedMixer::UseSimd(simd);
+        }
+        else if ((strcmp(argv[arg], "--engine") == 0) && (arg + 1 < argc))
+        {
+            const char* engine = argv[++arg];
+            if (strcmp(engine, "float") == 0)
+                Parameters::UseEngine(Parameters::engine_t::FLOAT);
+            else if (strcmp(engine, "fixed") == 0)
+                Parameters::UseEngine(Parameters::engine_t::FIXED);
+            else
+                Usage(argv[0]);
+        }
+        else if ((strcmp(argv[arg], "--params") == 0) && (arg + 1 < argc))
+        {
+            paramsFile = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--batch") == 0)
+        {
+            batch = true;
+        }
+        else
+        {
+            Usage(argv[0]);
+        }
+    }
+
+    if (argc - arg > 1)
+        Usage(argv[0]);
+
+    const char* chip = (arg < argc) ? argv[arg] : "6581R3_0486_S";
+
+    ParamStore store;
+    if (!store.Load(paramsFile))
+        exit(EXIT_FAILURE);
+
+    Corpus corpus;
+    if (!corpus.Open({ chip }))
+        exit(EXIT_FAILURE);
+
+    std::unique_ptr<BatchScorer> scorer;
+    if (batch)
+        scorer.reset(new BatchScorer(corpus));
+
+#ifdef _OPENMP
+    const int maxThreads = omp_get_max_threads();
+#else
+    const int maxThreads = 1;
+#endif
+
+    std::cout << "# chip " << chip << ", " << maxThreads << " threads, "
+              << (Parameters::GetEngine() == Parameters::engine_t::FIXED ? "fixed" : "float") << " engine";
+    if (scorer)
+        std::cout << ", batch scorer on the " << (scorer->IsOffloaded() ? "accelerator" : "host");
+    std::cout << std::endl
+              << "wave,distance,threads,early_exit,ns_per_sample,candidates_per_second,average_samples" << std::endl;
+
+    for (int wave: { 3, 5, 6, 7 })
+    {
+        ParamStore::entry_t entry;
+        if (!store.Get(chip, wave, entry))
+        {
+            std::cout << "No stored parameters for wave " << wave << std::endl;
+            continue;
+        }
+
+        const uint8_t* samples = corpus.Get(corpus.Find(chip), wave);
+        const ref_vector_t reference(samples, samples + Corpus::SAMPLES);
+
+        // the last pass scores all the distance functions at once
+        for (unsigned int d = 0; d <= DISTANCES; d++)
+        {
+            const bool allDistances = d == DISTANCES;
+            if (allDistances && scorer)
+                break;
+            const Distance_t distance = allDistances ? entry.params.distFunc : static_cast<Distance_t>(d);
+            const std::vector<Parameters> candidates = GetCandidates(entry.params, distance);
+
+            // stop at the score of the stored parameters as the optimizer does
+            Parameters best = entry.params;
+            best.distFunc = distance;
+            const unsigned int bestscore = best.Score(wave, entry.is8580, reference, 4096 * 255).audible_error;
+
+            for (int threads: { 1, maxThreads })
+            {
+#ifdef _OPENMP
+                omp_set_num_threads(threads);
+#endif
+                for (bool earlyExit: { false, true })
+                {
+                    if (earlyExit && scorer)
+                        break;
+
+                    const result_t result = Run(candidates, wave, entry.is8580, reference,
+                                                earlyExit ? bestscore : 4096 * 255, allDistances, seconds,
+                                                scorer.get(), corpus.Find(chip));
+                    std::cout << wave << ","
+                              << (allDistances ? "all" : GetDistanceName(distance)) << ","
+                              << threads << ","
+                              << (earlyExit ? "yes" : "no") << ","
+                              << std::fixed << std::setprecision(2)
+                              << result.nsPerSample << ","
+                              << std::setprecision(0)
+                              << result.candidatesPerSecond << ","
+                              << result.averageSamples << std::endl;
+                    std::cout.unsetf(std::ios_base::floatfield);
+                }
+
+                if (maxThreads == 1)
+                    break;
+            }
+        }
+    }
+}
@@ -0,0 +1,190 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "parameters.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+
+/**
+ * State of a running fit, enough to resume it exactly where it was left.
+ *
+ * The checkpoint is a small text file:
+ *
+ *     CWCK2
+ *     chip <name>
+ *     wave <n>
+ *     model <6581|8580>
+ *     best <distance> <threshold> <pulsestrength> <topbit> <distance1> <distance2>
+ *     score <audible_error> <wrong_bits> <rms>
+ *     current <distance> <threshold> <pulsestrength> <topbit> <distance1> <distance2>
+ *     evaluations <n>
+ *     last_improvement <n>
+ *     seconds <s>
+ *     last_improvement_seconds <s>
+ *     prng <state of the random generators>
+ *
+ * with all the values written with enough digits to be read back unchanged.
+ */
+struct checkpoint_t
+{
+    std::string chip;
+    int wave;
+    bool is8580;
+
+    Parameters bestparams;
+    score_t bestscore;
+
+    /// the candidate of the sequential search, which evolves from the previous one
+    Parameters current;
+
+    /// zero when there is nothing to resume
+    unsigned long evaluations;
+    unsigned long lastImprovement;
+
+    /// time spent in previous runs
+    double seconds;
+
+    /// time of the last improvement, including previous runs
+    double lastImprovementSeconds;
+
+    /// serialized state of the random number generators
+    std::string prng;
+
+    checkpoint_t() :
+        wave(0),
+        is8580(false),
+        evaluations(0),
+        lastImprovement(0),
+        seconds(0.),
+        lastImprovementSeconds(0.)
+    {}
+
+private:
+    static void WriteParams(std::ostream &out, const Parameters &p)
+    {
+        out << GetDistanceName(p.distFunc) << " "
+            << p.threshold << " " << p.pulsestrength << " " << p.topbit << " "
+            << p.distance1 << " " << p.distance2;
+    }
+
+    static bool ReadParams(std::istream &in, Parameters &p)
+    {
+        std::string distance;
+        in >> distance >> p.threshold >> p.pulsestrength >> p.topbit >> p.distance1 >> p.distance2;
+        return in && ParseDistanceName(distance.c_str(), p.distFunc);
+    }
+
+    static bool Expect(std::istream &in, const char* tag)
+    {
+        std::string s;
+        in >> s;
+        return in && (s == tag);
+    }
+
+public:
+    /**
+     * Write the checkpoint, replacing the file only once it's complete.
+     *
+     * @return false on error
+     */
+    bool Write(const char* file) const
+    {
+        const std::string tmp = std::string(file) + ".tmp";
+        {
+            std::ofstream ofs(tmp.c_str());
+            if (!ofs.is_open())
+                return false;
+
+            ofs.precision(std::numeric_limits<double>::max_digits10);
+            ofs << "CWCK2" << std::endl
+                << "chip " << chip << std::endl
+                << "wave " << wave << std::endl
+                << "model " << (is8580 ? "8580" : "6581") << std::endl
+                << "best ";
+            WriteParams(ofs, bestparams);
+            ofs << std::endl
+                << "score " << bestscore.audible_error << " " << bestscore.wrong_bits << " " << bestscore.rms << std::endl
+                << "current ";
+            WriteParams(ofs, current);
+            ofs << std::endl
+                << "evaluations " << evaluations << std::endl
+                << "last_improvement " << lastImprovement << std::endl
+                << "seconds " << seconds << std::endl
+                << "last_improvement_seconds " << lastImprovementSeconds << std::endl
+                << "prng " << prng << std::endl;
+            if (!ofs)
+                return false;
+        }
+        return std::rename(tmp.c_str(), file) == 0;
+    }
+
+    /**
+     * Read the checkpoint, also in the CWCK1 format of the previous versions,
+     * which had no time of the last improvement: the stall time then
+     * restarts from the resume.
+     *
+     * @return false if the file is missing or invalid
+     */
+    bool Read(const char* file)
+    {
+        std::ifstream ifs(file);
+        if (!ifs.is_open())
+            return false;
+
+        std::string magic;
+        if (!(ifs >> magic) || ((magic != "CWCK1") && (magic != "CWCK2")))
+            return false;
+        const bool v1 = magic == "CWCK1";
+
+        std::string model;
+        if (!Expect(ifs, "chip") || !(ifs >> chip)
+            || !Expect(ifs, "wave") || !(ifs >> wave)
+            || !Expect(ifs, "model") || !(ifs >> model)
+            || !Expect(ifs, "best") || !ReadParams(ifs, bestparams)
+            || !Expect(ifs, "score") || !(ifs >> bestscore.audible_error >> bestscore.wrong_bits >> bestscore.rms)
+            || !Expect(ifs, "current") || !ReadParams(ifs, current)
+            || !Expect(ifs, "evaluations") || !(ifs >> evaluations)
+            || !Expect(ifs, "last_improvement") || !(ifs >> lastImprovement)
+            || !Expect(ifs, "seconds") || !(ifs >> seconds))
+        {
+            return false;
+        }
+
+        if (v1)
+            lastImprovementSeconds = seconds;
+        else if (!Expect(ifs, "last_improvement_seconds") || !(ifs >> lastImprovementSeconds))
+            return false;
+
+        if (!Expect(ifs, "prng") || !std::getline(ifs >> std::ws, prng))
+            return false;
+
+        is8580 = model == "8580";
+        return true;
+    }
+};
+
+#endif
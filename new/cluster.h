@@ -0,0 +1,165 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include "corpus.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <vector>
+
+/**
+ * Clusters of chips with similar samples for a waveform.
+ *
+ * The distance between two chips is the audible error between
+ * their samples. The clusters are built bottom up with average linkage,
+ * merging the two closest clusters while their average distance
+ * is below a fraction of the median distance of all the pairs,
+ * so the threshold follows the spread of each waveform.
+ */
+class ChipClusters
+{
+public:
+    /// clusters closer than this fraction of the median distance are merged
+    static constexpr double LINKAGE = 0.25;
+
+private:
+    const unsigned int count;
+
+    /// distance between each pair of chips, count x count
+    std::vector<unsigned int> distances;
+
+    /// the chips of each cluster
+    std::vector<std::vector<unsigned int>> clusters;
+
+private:
+    double Average(const std::vector<unsigned int> &a, const std::vector<unsigned int> &b) const
+    {
+        double sum = 0.;
+        for (unsigned int i: a)
+            for (unsigned int j: b)
+                sum += Distance(i, j);
+        return sum / (a.size() * b.size());
+    }
+
+public:
+    ChipClusters(const Corpus &corpus, int wave) :
+        count(corpus.size()),
+        distances(count * count, 0)
+    {
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < static_cast<int>(count); i++)
+        {
+            for (unsigned int j = i + 1; j < count; j++)
+                distances[i * count + j] = distances[j * count + i] = corpus.Distance(i, j, wave);
+        }
+
+        for (unsigned int i = 0; i < count; i++)
+            clusters.push_back({ i });
+
+        if (count < 2)
+            return;
+
+        std::vector<unsigned int> pairs;
+        for (unsigned int i = 0; i < count; i++)
+            for (unsigned int j = i + 1; j < count; j++)
+                pairs.push_back(Distance(i, j));
+        std::nth_element(pairs.begin(), pairs.begin() + pairs.size() / 2, pairs.end());
+        const double threshold = LINKAGE * pairs[pairs.size() / 2];
+
+        for (;;)
+        {
+            double closest = std::numeric_limits<double>::max();
+            unsigned int a = 0;
+            unsigned int b = 0;
+            for (unsigned int i = 0; i < clusters.size(); i++)
+            {
+                for (unsigned int j = i + 1; j < clusters.size(); j++)
+                {
+                    const double d = Average(clusters[i], clusters[j]);
+                    if (d < closest)
+                    {
+                        closest = d;
+                        a = i;
+                        b = j;
+                    }
+                }
+            }
+
+            if (closest >= threshold)
+                break;
+
+            clusters[a].insert(clusters[a].end(), clusters[b].begin(), clusters[b].end());
+            clusters.erase(clusters.begin() + b);
+        }
+    }
+
+    /**
+     * Get the distance between two chips.
+     */
+    unsigned int Distance(unsigned int chip1, unsigned int chip2) const
+    {
+        return distances[chip1 * count + chip2];
+    }
+
+    /**
+     * Get the chips of each cluster.
+     */
+    const std::vector<std::vector<unsigned int>>& Clusters() const { return clusters; }
+
+    /**
+     * Get the members of the cluster nearest to the chip, by average distance,
+     * among the ones with some members accepted by the filter, the chip itself excluded.
+     *
+     * @return the accepted members, nearest first, empty if there are none
+     */
+    std::vector<unsigned int> Neighbors(unsigned int chip, const std::function<bool(unsigned int)> &filter) const
+    {
+        std::vector<unsigned int> best;
+        double nearest = std::numeric_limits<double>::max();
+        for (const std::vector<unsigned int> &cluster: clusters)
+        {
+            std::vector<unsigned int> members;
+            for (unsigned int i: cluster)
+            {
+                if (i != chip && filter(i))
+                    members.push_back(i);
+            }
+            if (members.empty())
+                continue;
+
+            const double d = Average({ chip }, members);
+            if (d < nearest)
+            {
+                nearest = d;
+                best = members;
+            }
+        }
+
+        std::sort(best.begin(), best.end(),
+            [this, chip](unsigned int a, unsigned int b) { return Distance(chip, a) < Distance(chip, b); });
+        return best;
+    }
+};
+
+#endif
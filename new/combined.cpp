@@ -20,7 +20,10 @@
  */
 
 #include <cassert>
-#include <ctime>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
 
 #include <iostream>
@@ -30,1601 +33,1206 @@
 #include <vector>
 #include <limits>
 #include <random>
+#include <mutex>
+#include <iterator>
+#include <chrono>
+#include <functional>
+#include <memory>
 
 #include "parameters.h"
+#include "scheduler.h"
+#include "chips.h"
+#include "corpus.h"
+#include "tables.h"
+#include "tablecache.h"
+#include "output.h"
+#include "store.h"
+#include "checkpoint.h"
+#include "stats.h"
+#include "search.h"
+#include "sweep.h"
+#include "cluster.h"
+#include "random.h"
 
 
-static const float EPSILON = 1e-4;
-
 #ifdef __MINGW32__
 // MinGW's std::random_device is a PRNG seeded with a constant value
 // so we use system time as a random seed.
 #include <chrono>
-inline long getSeed()
+inline uint64_t getSeed()
 {
     using namespace std::chrono;
     const auto now_ms = time_point_cast<std::chrono::milliseconds>(system_clock::now());
     return now_ms.time_since_epoch().count();
 }
 #else
-inline long getSeed()
+inline uint64_t getSeed()
 {
-    return std::random_device{}();
+    std::random_device rd;
+    return (static_cast<uint64_t>(rd()) << 32) | rd();
 }
 #endif
 
-static std::default_random_engine prng(getSeed());
-
-static std::normal_distribution<> normal_dist(1.0, 0.005);
-static std::normal_distribution<> normal_dist2(0.5, 0.2);
+/// set when the process is asked to terminate, to save a checkpoint before leaving
+static volatile std::sig_atomic_t interrupted = 0;
 
-static double GetRandomValue()
+static void Interrupt(int)
 {
-    return normal_dist(prng);
+    interrupted = 1;
 }
 
-static float GetNewRandomValue()
+/**
+ * Stop conditions of the optimizer, zero means no limit.
+ */
+struct stop_t
 {
-    return static_cast<float>(normal_dist2(prng));
-}
+    /// wall clock budget in seconds
+    double seconds;
 
-static void Optimize(const ref_vector_t &reference, int wave, const char* chip)
+    /// maximum number of evaluations
+    unsigned long evaluations;
+
+    /// maximum number of evaluations without improvement
+    unsigned long stall;
+
+    /// stop as soon as the audible error is not above this value
+    unsigned int target;
+
+    stop_t() :
+        seconds(0.),
+        evaluations(0),
+        stall(0),
+        target(0)
+    {}
+
+    /// whether the fit is bound to end even without reaching the target
+    bool isBounded() const { return (seconds > 0.) || (evaluations != 0) || (stall != 0); }
+};
+
+/**
+ * Search strategies.
+ */
+enum class strategy_t
 {
-    Parameters bestparams;
+    /// random walk from the best parameters
+    MONTE_CARLO,
 
-    bool is8580 = false;
+    /// differential evolution of a population
+    DIFFERENTIAL_EVOLUTION,
 
-    /*
-     * The score here reported is the acoustic error.
-     * In parentheses the number of mispredicted bits
-     * on a total of 32768.
-     */
-#if 1
-    if (strcmp(chip, "locu128_6581_cbm_4383") == 0)
+    /// concurrent Monte Carlo chains with different mutation widths
+    CHAINS
+};
+
+/// default population of the differential evolution
+static const unsigned int DE_POPULATION = 20;
+
+/**
+ * Optimizer settings.
+ */
+struct options_t
+{
+    strategy_t strategy;
+
+    /// number of candidates evaluated concurrently, sequential search if less than two,
+    /// or the size of the population of the differential evolution
+    unsigned int population;
+
+    /// score first the values where the current best has the largest errors
+    bool adaptiveOrder;
+
+    /// number of chains of the multi-chain search
+    unsigned int chains;
+
+    /// search also the best distance function
+    bool distances;
+
+    /// when to stop the fit
+    stop_t stop;
+
+    /// dump the predicted values for the initial parameters
+    bool dump;
+
+    /// file where the dump is written instead of the progress stream, if any
+    const char* dumpFile;
+
+    /// don't print the ties and the dump
+    bool quiet;
+
+    /// file where the state of the fit is saved, if any
+    const char* checkpoint;
+
+    /// seconds between checkpoints
+    double checkpointInterval;
+
+    /// seconds between reports of the statistics
+    double statsInterval;
+
+    /// seed of the random generators
+    uint64_t seed;
+
+    options_t() :
+        strategy(strategy_t::MONTE_CARLO),
+        population(0),
+        adaptiveOrder(false),
+#ifdef _OPENMP
+        chains(omp_get_max_threads()),
+#else
+        chains(2),
+#endif
+        distances(false),
+        dump(true),
+        dumpFile(nullptr),
+        quiet(false),
+        checkpoint(nullptr),
+        checkpointInterval(60.),
+        statsInterval(10.),
+        seed(0)
+    {}
+};
+
+/**
+ * Result of a fit.
+ */
+struct result_t
+{
+    Parameters params;
+    score_t score;
+    unsigned long evaluations;
+    double seconds;
+
+    /// false if the fit couldn't start, the error has been reported
+    bool ok;
+
+    result_t() :
+        evaluations(0),
+        seconds(0.),
+        ok(false)
+    {}
+};
+
+/**
+ * Get the initial parameters for the given chip and waveform.
+ *
+ * @return false if the store has no parameters for them
+ */
+static bool GetInitialParams(const ParamStore &store, const char* chip, int wave, Parameters &bestparams, bool &is8580)
+{
+    ParamStore::entry_t entry;
+    if (!store.Get(chip, wave, entry))
     {
-        switch (wave)
-        {
-        case 3: // ST
-            // current score 1474 (198/32768) [RMS: 62.81]
-            bestparams.threshold = 0.892563999f;
-            bestparams.topbit = 1.11905622f;
-            bestparams.distance1 = 2.21876144f;
-            bestparams.distance2 = 9.63837719f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 612 (102/32768) [RMS: 43.71]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.01262534f;
-            bestparams.pulsestrength = 2.46070528f;
-            bestparams.distance1 = 0.0537485816f;
-            bestparams.distance2 = 0.0986242667f;
-            break;
-        case 6: // PS
-            // current score 8135 (575/32768) [RMS: 75.10]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 2.14896345f;
-            bestparams.pulsestrength = 10.5400085f;
-            bestparams.topbit = 1.0216713f;
-            bestparams.distance1 = 0.244498149f;
-            bestparams.distance2 = 0.126134038f;
-            break;
-        case 7: // PST
-            // current 2489 (60/32768) [RMS: 24.41]
-            bestparams.threshold = 1.22330308f;
-            bestparams.pulsestrength = 2.83245254f;
-            bestparams.topbit = 0.933797896f;
-            bestparams.distance1 = 0.0615176819f;
-            bestparams.distance2 = 0.323831677f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
-        }
+        bestparams.reset();
+        is8580 = false;
+        return false;
     }
 
-    else if (strcmp(chip, "6581_0784") == 0)
-    {
-        switch (wave)
+    bestparams = entry.params;
+    is8580 = entry.is8580;
+    return true;
+}
+
+/**
+ * Get the initial parameters for a chip with none stored,
+ * from the related chips: the stored parameters of the members of the nearest cluster
+ * are scored against the samples of the chip and the best ones are used.
+ *
+ * @param from the chip whose parameters are used
+ * @return false if no related chip has stored parameters
+ */
+static bool GetWarmStart(const ParamStore &store, const Corpus &corpus, const ChipClusters &clusters,
+                         const char* chip, int wave, const ref_vector_t &reference,
+                         Parameters &bestparams, bool &is8580, std::string &from)
+{
+    const std::vector<unsigned int> neighbors = clusters.Neighbors(corpus.Find(chip),
+        [&](unsigned int i)
         {
-        case 3: // ST
-            // current score 10021 (385/32768) [RMS: 65.16]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.823114872f;
-            bestparams.topbit = 1.29229462f;
-            bestparams.distance1 = 2.96363974f;
-            bestparams.distance2 = 6.07001877f;
-            break;
-        case 5: // PT
-            // current score 2016 (141/32768) [RMS: 52.18]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.938275278f;
-            bestparams.pulsestrength = 1.70019507f;
-            bestparams.distance1 = 1.10584641f;
-            bestparams.distance2 = 1.11688411f;
-            break;
-        case 6: // PS
-            // current score 12765 (629/32768) [RMS: 87.66]
-            bestparams.threshold = 2.09155488f;
-            bestparams.pulsestrength = 8.82649231f;
-            bestparams.topbit = 1.10415828f;
-            bestparams.distance1 = 0.328211099f;
-            bestparams.distance2 = 0.196435586f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
-        case 7: // PST
-            // current score 4088 (106/32768) [RMS: 31.40]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 1.14416945f;
-            bestparams.pulsestrength = 3.07632709f;
-            bestparams.distance1 = 0.674530327f;
-            bestparams.distance2 = 1.17008042f;
-            break;
-        }
-    }
+            ParamStore::entry_t entry;
+            return store.Get(corpus.GetName(i), wave, entry);
+        });
 
-    else if (strcmp(chip, "6581_3084") == 0)
+    score_t bestscore;
+    for (unsigned int i: neighbors)
     {
-        switch (wave)
+        ParamStore::entry_t entry;
+        store.Get(corpus.GetName(i), wave, entry);
+        const score_t score = entry.params.Score(wave, entry.is8580, reference, 4096 * 255);
+        if (from.empty() || bestscore.isBetter(score))
         {
-        case 3: // ST
-            // current score 6329 (332/32768) [RMS: 72.16]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.918491125f;
-            bestparams.topbit = 1.45740879f;
-            bestparams.distance1 = 7.97798014f;
-            bestparams.distance2 = 20.3139534f;
-            break;
-        case 5: // PT
-            // current score 5781 (198/32768) [RMS: 66.75]
-            bestparams.threshold = 0.999375761f;
-            bestparams.pulsestrength = 2.03652263f;
-            bestparams.distance1 = 1.05754781f;
-            bestparams.distance2 = 1.15805364f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 19251 (820/32768) [RMS: 96.08]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 2.03611517f;
-            bestparams.pulsestrength = 6.61680031f;
-            bestparams.topbit = 1.00762045f;
-            bestparams.distance1 = 0.532329381f;
-            bestparams.distance2 = 0.353334934f;
-            break;
-        case 7: // PST
-            // current score 5468 (97/32768) [RMS: 40.86]
-            bestparams.threshold = 1.14943659f;
-            bestparams.pulsestrength = 1.46092212f;
-            bestparams.topbit = 0.848984182f;
-            bestparams.distance1 = 0.281330794f;
-            bestparams.distance2 = 1.01946712f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
+            bestparams = entry.params;
+            bestscore = score;
+            is8580 = entry.is8580;
+            from = entry.chip;
         }
     }
+    return !from.empty();
+}
+
+/**
+ * Get the score of the parameters in the floating point model,
+ * the one the store is kept in, rescoring them if the fit uses another engine.
+ */
+static score_t GetStoredScore(const Parameters &p, const score_t &score, int wave, bool is8580,
+                              const ref_vector_t &reference)
+{
+    return (Parameters::GetEngine() == Parameters::engine_t::FLOAT)
+        ? score
+        : p.Score(Parameters::engine_t::FLOAT, wave, is8580, reference, 4096 * 255);
+}
+
+/**
+ * Score the candidate with each of the distance functions
+ * and switch it to the best one.
+ */
+static score_t ScoreBestDistance(Parameters &p, int wave, bool is8580, const ref_vector_t &reference,
+                                 unsigned int bound, const order_vector_t *order)
+{
+    score_t scores[DISTANCES];
+    p.ScoreDistances(wave, is8580, reference, bound, order, scores);
 
-    else if (strcmp(chip, "cbm3384") == 0)
+    // keep the current function unless another one is strictly better
+    unsigned int best = static_cast<unsigned int>(p.distFunc);
+    for (unsigned int d = 0; d < DISTANCES; d++)
     {
-        switch (wave)
-        {
-        case 3: // ST
-            // current score 16820 (1031/32768) [RMS: 87.00]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.000224893636f;
-            bestparams.topbit = 0.000224897463f;
-            bestparams.distance1 = 0.000115541166f;
-            bestparams.distance2 = 1.84193969f;
-            break;
-        case 5: // PT
-            // current score 3620 (42/32768) [RMS: 70.36]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 0.984425008f;
-            bestparams.pulsestrength = 2.35668468f;
-            bestparams.distance1 = 0.0199570525f;
-            bestparams.distance2 = 0.175396249f;
-            break;
-        case 6: // PS
-            // current score 20269 (1394/32768) [RMS: 102.93]
-            bestparams.threshold = 2.72176981f;
-            bestparams.pulsestrength = 11.8026724f;
-            bestparams.topbit = 1.12436867f;
-            bestparams.distance1 = 0.414662331f;
-            bestparams.distance2 = 0.239115238f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
-        case 7: // PST
-            // current score 7752 (151/32768) [RMS: 43.90]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.19250798f;
-            bestparams.pulsestrength = 2.32080412f;
-            bestparams.topbit = 0.955280125f;
-            bestparams.distance1 = 0.0681763813f;
-            bestparams.distance2 = 0.604984641f;
-            break;
-        }
+        if (scores[best].isBetter(scores[d]))
+            best = d;
     }
+    p.distFunc = static_cast<Distance_t>(best);
+    return scores[best];
+}
 
-    else if (strcmp(chip, "cbm4383") == 0)
+/**
+ * Write the comparison of the predicted values with the reference,
+ * to options.dumpFile in the format given by its extension, .csv or .bin,
+ * or as text to out.
+ *
+ * @return false if the file can't be opened
+ */
+static bool Dump(const Parameters &params, int wave, const ref_vector_t &reference,
+                 const options_t &options, std::ostream &out)
+{
+    if (!options.dumpFile)
     {
-        switch (wave)
-        {
-        case 3: // ST
-            // current score 5537 (924/32768) [RMS: 79.93]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.00673561823f;
-            bestparams.topbit = 0.0067387647f;
-            bestparams.distance1 = 0.00215783017f;
-            bestparams.distance2 = 9.49551773f;
-            break;
-        case 5: // PT
-            // current score 2130 (131/32768) [RMS: 64.83]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.00092328f;
-            bestparams.pulsestrength = 2.42803788f;
-            bestparams.distance1 = 0.0113755139f;
-            bestparams.distance2 = 0.162516415f;
-            break;
-        case 6: // PS
-            // current score 19304 (1054/32768) [RMS: 96.13]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 2.42779779f;
-            bestparams.pulsestrength = 9.93910408f;
-            bestparams.topbit = 1.12610471f;
-            bestparams.distance1 = 0.411725849f;
-            bestparams.distance2 = 0.245940804f;
-            break;
-        case 7: // PST
-            // current score 6364 (107/32768) [RMS: 39.55]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.01210797f;
-            bestparams.pulsestrength = 1.34227395f;
-            bestparams.topbit = 0.786518633f;
-            bestparams.distance1 = 0.0586184449f;
-            bestparams.distance2 = 0.824515998f;
-            break;
-        }
+        if (!options.quiet)
+            Dump(params, wave, reference, dump_t::TEXT, out);
+        return true;
     }
 
-    else if (strcmp(chip, "6581R4AR_3789_14") == 0)
+    const char* ext = strrchr(options.dumpFile, '.');
+    const dump_t format = !ext ? dump_t::TEXT
+        : (strcmp(ext, ".csv") == 0) ? dump_t::CSV
+        : (strcmp(ext, ".bin") == 0) ? dump_t::BINARY
+        : dump_t::TEXT;
+
+    std::ofstream ofs(options.dumpFile, format == dump_t::BINARY ? std::ofstream::binary : std::ofstream::out);
+    if (!ofs.is_open())
     {
-        switch (wave)
-        {
-        case 3: // ST
-            // current score 5504 (312/32768) [RMS: 72.74]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.973038077f;
-            bestparams.topbit = 1.43141603f;
-            bestparams.distance1 = 5.40211439f;
-            bestparams.distance2 = 47.9917068f;
-            break;
-        case 5: // PT
-            // current score 4621 (104/32768) [RMS: 66.23]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 0.978124142f;
-            bestparams.pulsestrength = 2.08345437f;
-            bestparams.distance1 = 0.0454150252f;
-            bestparams.distance2 = 0.203794882f;
-            break;
-        case 6: // PS
-            // current score 22207 (880/32768) [RMS: 96.91]
-            bestparams.threshold = 1.96628845f;
-            bestparams.pulsestrength = 6.81508446f;
-            bestparams.topbit = 1.00600147f;
-            bestparams.distance1 = 0.423710018f;
-            bestparams.distance2 = 0.307503849f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
-        case 7: // PST
-            // current score 5404 (100/32768) [RMS: 40.99]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.09994781f;
-            bestparams.pulsestrength = 1.55916071f;
-            bestparams.topbit = 0.93129617f;
-            bestparams.distance1 = 0.137331873f;
-            bestparams.distance2 = 0.820938587f;
-            break;
-        }
+        std::cout << "Error opening file " << options.dumpFile << std::endl;
+        return false;
     }
+    Dump(params, wave, reference, format, ofs);
+    return true;
+}
 
-    else if (strcmp(chip, "6581R4AR_4486_14") == 0)
+/**
+ * Fit the model parameters to the sampled data.
+ *
+ * @param initial the starting parameters
+ * @param out the stream where progress is reported
+ * @param improved called each time better parameters are found
+ * @param report called every options.statsInterval seconds, and at the end, with the statistics of the fit
+ * @param checkpoint if not null the fit is resumed from it, when not empty,
+ *                   and periodically saved to options.checkpoint
+ * @return the best parameters found, not ok if the checkpoint holds an invalid
+ *         random state or the dump file can't be written
+ */
+static result_t Optimize(const ref_vector_t &reference, int wave, const Parameters &initial, bool is8580,
+                         const options_t &options, std::ostream &out,
+                         const std::function<void(const Parameters&, const score_t&)> &improved,
+                         const std::function<void(const fit_stats_t&)> &report,
+                         checkpoint_t *checkpoint = nullptr)
+{
+    Parameters bestparams = initial;
+    score_t bestscore;
+    Parameters current;
+    random_t rng(options.seed);
+    unsigned long evaluations = 1;
+    unsigned long lastImprovement = evaluations;
+    double previousSeconds = 0.;
+    double lastImprovementTime = 0.;
+
+    if (checkpoint && checkpoint->evaluations)
     {
-        switch (wave)
+        bestparams = checkpoint->bestparams;
+        bestscore = checkpoint->bestscore;
+        current = checkpoint->current;
+        evaluations = checkpoint->evaluations;
+        lastImprovement = checkpoint->lastImprovement;
+        previousSeconds = checkpoint->seconds;
+        lastImprovementTime = checkpoint->lastImprovementSeconds;
+        if (!rng.SetState(checkpoint->prng))
         {
-        case 3: // ST
-            // current score 25195 (1197/32768) [RMS: 80.06]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.0993857682f;
-            bestparams.topbit = 0.105061948f;
-            bestparams.distance1 = 0.0556670353f;
-            bestparams.distance2 = 2.12972975f;
-            break;
-        case 5: // PT
-            // current score 3604 (63/32768) [RMS: 70.47]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 0.998088539f;
-            bestparams.pulsestrength = 2.51015329f;
-            bestparams.distance1 = 0.0422255732f;
-            bestparams.distance2 = 0.164421782f;
-            break;
-        case 6: // PS
-            // current score 19624 (1177/32768) [RMS: 101.84]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 2.35510826f;
-            bestparams.pulsestrength = 10.1756306f;
-            bestparams.distance1 = 0.353252262f;
-            bestparams.distance2 = 0.22332482f;
-            break;
-        case 7: // PST
-            // current score 7250 (153/32768) [RMS: 43.42]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.20486581f;
-            bestparams.pulsestrength = 2.13962531f;
-            bestparams.topbit = 0.961478889f;
-            bestparams.distance1 = 0.138547704f;
-            bestparams.distance2 = 0.68967092f;
-            break;
+            std::cout << "Invalid random state in checkpoint" << std::endl;
+            return result_t();
         }
+        out << "# resumed score " << std::dec
+            << bestscore << std::endl
+            << ToString(bestparams) << std::endl
+            << "# after " << evaluations << " evaluations" << std::endl << std::endl;
     }
-
-    else if (strcmp(chip, "6581R4AR_5286_14") == 0)
+    else
     {
-        switch (wave)
-        {
-        case 3: // ST
-            // current score 18860 (1155/32768) [RMS: 79.93]6581R4AR_5286_14
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.00316550909f;
-            bestparams.topbit = 0.00317018107f;
-            bestparams.distance1 = 0.00221686065f;
-            bestparams.distance2 = 10.0225477f;
-            break;
-        case 5: // PT
-            // current score 5586 (147/32768) [RMS: 80.44]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.965520382f;
-            bestparams.pulsestrength = 1.97317994f;
-            bestparams.distance1 = 1.03463221f;
-            bestparams.distance2 = 1.17572582f;
-            break;
-        case 6: // PS
-            // current score 21336 (1258/32768) [RMS: 106.95]
-            bestparams.threshold = 1.80564773f;
-            bestparams.pulsestrength = 4.75714445f;
-            bestparams.topbit = 1.00152075f;
-            bestparams.distance1 = 0.50254482f;
-            bestparams.distance2 = 0.525642395f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
-        case 7: // PST
-            // current score 7382 (124/32768) [RMS: 49.47]
-            bestparams.threshold = 1.03704965f;
-            bestparams.pulsestrength = 1.37006736f;
-            bestparams.topbit = 0.771614373f;
-            bestparams.distance1 = 0.130179495f;
-            bestparams.distance2 = 1.02845287f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
-        }
+        if (options.dump && !Dump(bestparams, wave, reference, options, out))
+            return result_t();
+
+        // Calculate current score
+        bestscore = options.distances
+            ? ScoreBestDistance(bestparams, wave, is8580, reference, 4096 * 255, nullptr)
+            : bestparams.Score(wave, is8580, reference, 4096 * 255);
+        out << "# initial score " << std::dec
+            << bestscore << std::endl
+            << ToString(bestparams) << std::endl << std::endl;
+        current = bestparams;
     }
 
-    else if (strcmp(chip, "6581R3_0486_S") == 0)
+    /*
+     * The search strategy randomly alters the parameters and
+     * the candidates are scored until we find the best fitting
+     * waveform compared to the sampled data.
+     */
+    std::unique_ptr<Search> search;
+    MonteCarlo *walk = nullptr;
+    if (options.strategy == strategy_t::DIFFERENTIAL_EVOLUTION)
     {
-        switch (wave)
-        {
-        case 3: // ST
-            // current score 3555 (324/32768) [RMS: 73.98]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.877322257f;
-            bestparams.topbit = 1.11349654f;
-            bestparams.distance1 = 2.14537621f;
-            bestparams.distance2 = 9.08618164f;
-            break;
-        case 5: // PT
-            // current score 4590 (124/32768) [RMS: 68.90]
-            bestparams.threshold = 0.941692829f;
-            bestparams.pulsestrength = 1.80072665f;
-            bestparams.distance1 = 0.033124879f;
-            bestparams.distance2 = 0.232303441f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
-        case 6: // PS
-            // current score 19352 (763/32768) [RMS: 96.91]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.66494179f;
-            bestparams.pulsestrength = 5.62705326f;
-            bestparams.topbit = 1.03760982f;
-            bestparams.distance1 = 0.291590303f;
-            bestparams.distance2 = 0.283631504f;
-            break;
-        case 7: // PST
-            // current score 5068 (94/32768) [RMS: 41.69]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.09762526f;
-            bestparams.pulsestrength = 1.52196741f;
-            bestparams.topbit = 0.975265801f;
-            bestparams.distance1 = 0.151528224f;
-            bestparams.distance2 = 0.841949463f;
-            break;
-        }
+        search.reset(new DifferentialEvolution<Philox>(bestparams, wave,
+            options.population > 1 ? options.population : DE_POPULATION, rng.prng));
     }
-
-    else if (strcmp(chip, "6581R3_4785") == 0)
+    else if (options.strategy == strategy_t::CHAINS)
     {
-        switch (wave)
-        {
-        case 3: // ST
-            // current score 2298 (339/32768) [RMS: 63.96]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.776678205f;
-            bestparams.topbit = 1.18439901f;
-            bestparams.distance1 = 2.25732255f;
-            bestparams.distance2 = 5.12803745f;
-            break;
-        case 5: // PT
-            // current score 582 (57/32768) [RMS: 45.61]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.01866758f;
-            bestparams.pulsestrength = 2.69177628f;
-            bestparams.distance1 = 0.0233543925f;
-            bestparams.distance2 = 0.0850229636f;
-            break;
-        case 6: // PS
-            // current score 9242 (679/32768) [RMS: 79.56]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 2.20329857f;
-            bestparams.pulsestrength = 10.5146885f;
-            bestparams.topbit = 1.04501438f;
-            bestparams.distance1 = 0.277294368f;
-            bestparams.distance2 = 0.143747061f;
-            break;
-        case 7: // PST
-            // current score 2767 (66/32768) [RMS: 26.39]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.28576732f;
-            bestparams.pulsestrength = 2.84452748f;
-            bestparams.topbit = 1.04538679f;
-            bestparams.distance1 = 0.151578978f;
-            bestparams.distance2 = 0.389423102f;
-            break;
-        }
+        search.reset(new Chains(bestparams, bestscore, wave, options.chains,
+            rng.prng.GetSeed(), evaluations, !options.distances));
     }
-
-    else if (strcmp(chip, "6581R3_4885") == 0)
+    else
     {
-        switch (wave)
-        {
-        case 3: // ST
-            // current score 7286 (397/32768) [RMS: 75.32]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.759519219f;
-            bestparams.topbit = 1.28535891f;
-            bestparams.distance1 = 2.08408093f;
-            bestparams.distance2 = 4.26385403f;
-            break;
-        case 5: // PT
-            // current score 1956 (36/32768) [RMS: 65.23]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 0.992383003f;
-            bestparams.pulsestrength = 2.49721408f;
-            bestparams.distance1 = 0.0148989018f;
-            bestparams.distance2 = 0.14348942f;
-            break;
-        case 6: // PS
-            // current score 18924 (892/32768) [RMS: 94.14]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 2.57584476f;
-            bestparams.pulsestrength = 13.8990936f;
-            bestparams.topbit = 1.17231143f;
-            bestparams.distance1 = 0.202597454f;
-            bestparams.distance2 = 0.128030822f;
-            break;
-        case 7: // PST
-            // current score 5575 (118/32768) [RMS: 36.88]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.15620351f;
-            bestparams.pulsestrength = 2.5087378f;
-            bestparams.distance1 = 0.0456474312f;
-            bestparams.distance2 = 0.433534175f;
-            break;
-        }
+        walk = new MonteCarlo(bestparams, bestscore, current, wave, options.population,
+            rng, evaluations, !options.distances);
+        search.reset(walk);
     }
 
-    else if (strcmp(chip, "6581R4AR_3488_14") == 0)
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&start, previousSeconds]()
     {
-        switch (wave)
-        {
-        case 3: // ST
-            // current score 2207 (302/32768) [RMS: 64.27]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.769770384f;
-            bestparams.topbit = 1.19125676f;
-            bestparams.distance1 = 2.24802995f;
-            bestparams.distance2 = 4.92881823f;
-            break;
-        case 5: // PT
-            // current score 3518 (72/32768) [RMS: 64.69]
-            bestparams.threshold = 0.963632345f;
-            bestparams.pulsestrength = 2.06904531f;
-            bestparams.distance1 = 0.0287600756f;
-            bestparams.distance2 = 0.183034822f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
-        case 6: // PS
-            // current score 20496 (988/32768) [RMS: 93.51]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.14159644f;
-            bestparams.pulsestrength = 3.50420499f;
-            bestparams.topbit = 0.748402119f;
-            bestparams.distance1 = 0.00319250347f;
-            bestparams.distance2 = 0.218578994f;
-            break;
-        case 7: // PST
-            // current score 5006 (102/32768) [RMS: 35.64]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.08452392f;
-            bestparams.pulsestrength = 1.81916571f;
-            bestparams.topbit = 0.904740691f;
-            bestparams.distance1 = 0.0277621783f;
-            bestparams.distance2 = 0.585185289f;
-            break;
-        }
-    }
+        return previousSeconds + std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
 
-    else if (strcmp(chip, "6581_1585") == 0)
+    auto save = [&]()
     {
-        switch (wave)
+        checkpoint->wave = wave;
+        checkpoint->is8580 = is8580;
+        // only the Monte Carlo walk supports the checkpoints, its base
+        // can be a tie of the best parameters
+        checkpoint->bestparams = walk->Member(0);
+        checkpoint->bestscore = bestscore;
+        checkpoint->current = walk->Current();
+        checkpoint->evaluations = evaluations;
+        checkpoint->lastImprovement = lastImprovement;
+        checkpoint->seconds = elapsed();
+        checkpoint->lastImprovementSeconds = lastImprovementTime;
+        checkpoint->prng = rng.GetState();
+        if (!checkpoint->Write(options.checkpoint))
+            std::cout << "Error writing checkpoint " << options.checkpoint << std::endl;
+    };
+    double nextCheckpoint = elapsed() + options.checkpointInterval;
+
+    fit_stats_t stats;
+    stats.evaluations = evaluations;
+    auto publish = [&]()
+    {
+        stats.seconds = elapsed();
+        stats.sinceImprovement = stats.seconds - lastImprovementTime;
+        stats.best = bestscore;
+        report(stats);
+    };
+    double nextStats = elapsed() + options.statsInterval;
+
+    const stop_t &stop = options.stop;
+    auto running = [&]()
+    {
+        // between two iterations the state is consistent, save it here
+        if (checkpoint && (elapsed() >= nextCheckpoint))
         {
-        case 3: // ST
-            // current score 8719 (948/32768) [RMS: 70.29]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.174544901f;
-            bestparams.topbit = 0.180504948f;
-            bestparams.distance1 = 0.107921958f;
-            bestparams.distance2 = 2.36725044f;
-            break;
-        case 5: // PT
-            // current score 1933 (96/32768) [RMS: 52.54]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 0.984207988f;
-            bestparams.pulsestrength = 1.83862209f;
-            bestparams.distance1 = 0.151734218f;
-            bestparams.distance2 = 0.202220336f;
-            break;
-        case 6: // PS
-            // current score 17068 (1170/32768) [RMS: 86.36]
-            bestparams.threshold = 1.48120451f;
-            bestparams.pulsestrength = 6.19636726f;
-            bestparams.topbit = 0.831328928f;
-            bestparams.distance1 = 0.000226263714f;
-            bestparams.distance2 = 0.144217432f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
-        case 7: // PST
-            // current score 4075 (76/32768) [RMS: 30.81]
-            bestparams.threshold = 1.02086127f;
-            bestparams.pulsestrength = 1.57034767f;
-            bestparams.topbit = 0.865189075f;
-            bestparams.distance1 = 0.0384464264f;
-            bestparams.distance2 = 0.529835522f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
+            save();
+            nextCheckpoint = elapsed() + options.checkpointInterval;
         }
-    }
 
-    else if (strcmp(chip, "6581R4AR_3586_S") == 0)
-    {
-        switch (wave)
+        if (report && (elapsed() >= nextStats))
         {
-        case 3: // ST
-            // current score 1887 (215/32768) [RMS: 64.97]
-            bestparams.threshold = 0.94858247f;
-            bestparams.pulsestrength = 1.f;
-            bestparams.topbit = 1.05520427f;
-            bestparams.distance1 = 2.20595884f;
-            bestparams.distance2 = 20.6003361f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 2993 (151/32768) [RMS: 60.65]
-            bestparams.threshold = 0.972008884f;
-            bestparams.pulsestrength = 1.71443033f;
-            bestparams.distance1 = 0.141484126f;
-            bestparams.distance2 = 0.257483304f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
-        case 6: // PS
-            // current score 18550 (1118/32768) [RMS: 92.80]
-            bestparams.threshold = 2.67324972f;
-            bestparams.pulsestrength = 11.9622126f;
-            bestparams.topbit = 1.22654665f;
-            bestparams.distance1 = 0.399144709f;
-            bestparams.distance2 = 0.207783923f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
-        case 7: // PST
-            // current score 4911 (91/32768) [RMS: 36.56]
-            bestparams.threshold = 1.15800464f;
-            bestparams.pulsestrength = 1.93585241f;
-            bestparams.topbit = 0.940164089f;
-            bestparams.distance1 = 0.0932772979f;
-            bestparams.distance2 = 0.64203608f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
+            publish();
+            nextStats = elapsed() + options.statsInterval;
         }
-    }
 
-    else if (strcmp(chip, "8580R5_5092_25") == 0)
-    {
-        is8580 = true;
+        return !interrupted
+            && (bestscore.audible_error > stop.target)
+            && ((stop.evaluations == 0) || (evaluations < stop.evaluations))
+            && ((stop.stall == 0) || (evaluations - lastImprovement < stop.stall))
+            && ((stop.seconds <= 0.) || (elapsed() < stop.seconds));
+    };
 
-        switch (wave)
-        {
-        case 3: // ST
-            // current score 1193 (168/32768) [RMS: 55.37]
-            bestparams.threshold = 0.6865291f;
-            bestparams.topbit = 0.941219449f;
-            bestparams.distance1 = 1.20599532f;
-            bestparams.distance2 = 2.1035006f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 5649 (251/32768) [RMS: 121.74]
-            bestparams.threshold = 0.947981834f;
-            bestparams.pulsestrength = 1.1519047f;
-            bestparams.distance1 = 1.02821982f;
-            bestparams.distance2 = 1.66400278f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 7620 (454/32768) [RMS: 114.15]
-            bestparams.distFunc = Parameters::quadraticDistance;
-            bestparams.threshold = 0.963866293f;
-            bestparams.pulsestrength = 1.22095084f;
-            bestparams.topbit = 1.01380754f;
-            bestparams.distance1 = 0.0110885892f;
-            bestparams.distance2 = 0.381492466f;
-            break;
-        case 7: // PST
-            // current score 3693 (116/32768) [RMS: 65.11]
-            bestparams.threshold = 0.976278663f;
-            bestparams.pulsestrength = 0.203671157f;
-            bestparams.topbit = 0.987689197f;
-            bestparams.distance1 = 0.954125166f;
-            bestparams.distance2 = 9.32865429f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
-        }
+    order_vector_t order;
+    const order_vector_t *sampleOrder = nullptr;
+    if (options.adaptiveOrder)
+    {
+        order = bestparams.GetSampleOrder(wave, reference);
+        sampleOrder = &order;
     }
 
-    else if (strcmp(chip, "8580R5_5092_25_2") == 0)
+    // score a candidate, choosing also its best distance function if requested,
+    // re-using the mix in the cache if the distances are the same
+    auto evaluate = [&](Parameters &p, unsigned int bound, mix_cache_t *cache)
     {
-        is8580 = true;
-
-        switch (wave)
+        return options.distances ? ScoreBestDistance(p, wave, is8580, reference, bound, sampleOrder)
+            : cache ? p.Score(wave, is8580, reference, bound, sampleOrder, *cache)
+            : p.Score(wave, is8580, reference, bound, sampleOrder);
+    };
+
+    // report when the winning distance function changes
+    Distance_t distFunc = bestparams.distFunc;
+    auto reportDistance = [&]()
+    {
+        if (options.distances && (bestparams.distFunc != distFunc))
         {
-        case 3: // ST
-            // current score 1048 (120/32768) [RMS: 53.74]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.814103305f;
-            bestparams.topbit = 1.17548299f;
-            bestparams.distance1 = 1.88967574f;
-            bestparams.distance2 = 2.32063961f;
-            break;
-        case 5: // PT
-            // current score 3670 (140/32768) [RMS: 122.32]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.990784764f;
-            bestparams.pulsestrength = 1.18064904f;
-            bestparams.distance1 = 1.04774177f;
-            bestparams.distance2 = 1.72867715f;
-            break;
-        case 6: // PS
-            // current score 9312 (398/32768) [RMS: 114.87]
-            bestparams.distFunc = Parameters::quadraticDistance;
-            bestparams.threshold = 0.980230451f;
-            bestparams.pulsestrength = 1.17020738f;
-            bestparams.topbit = 0.987197578f;
-            bestparams.distance1 = 0.0191217829f;
-            bestparams.distance2 = 0.472027928f;
-            break;
-        case 7: // PST
-            // current score 2955 (63/32768) [RMS: 63.95]
-            bestparams.threshold = 0.926966071f;
-            bestparams.pulsestrength = 0.624513328f;
-            bestparams.topbit = 1.18132031f;
-            bestparams.distance1 = 1.17270482f;
-            bestparams.distance2 = 1.83883405f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
+            distFunc = bestparams.distFunc;
+            out << "# distance function " << GetDistanceName(distFunc) << std::endl;
         }
-    }
+    };
 
-    else if (strcmp(chip, "8580_3493") == 0)
+    std::vector<score_t> scores;
+    while (running())
     {
-        is8580 = true;
+        std::vector<Parameters> &candidates = search->Ask();
+        scores.resize(candidates.size());
 
-        switch (wave)
+        // a single candidate is scored by all the threads
+        if (candidates.size() == 1)
         {
-        case 3: // ST
-            // current score 2190 (246/32768) [RMS: 56.75]
-            bestparams.threshold = 0.731061876f;
-            bestparams.topbit = 1.01355672f;
-            bestparams.distance1 = 1.64468837f;
-            bestparams.distance2 = 3.43933249f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 5735 (232/32768) [RMS: 112.40]
-            bestparams.threshold = 0.936719835f;
-            bestparams.pulsestrength = 1.17875373f;
-            bestparams.distance1 = 1.04700363f;
-            bestparams.distance2 = 1.50305116f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 10895 (435/32768) [RMS: 107.54]
-            bestparams.threshold = 0.944479704f;
-            bestparams.pulsestrength = 1.19168735f;
-            bestparams.topbit = 0.990218341f;
-            bestparams.distance1 = 0.00204254151f;
-            bestparams.distance2 = 0.296270579f;
-            bestparams.distFunc = Parameters::quadraticDistance;
-            break;
-        case 7: // PST
-            // current score 8848 (111/32768) [RMS: 60.29]
-            bestparams.threshold = 0.943110585f;
-            bestparams.pulsestrength = 1.0835638f;
-            bestparams.topbit = 1.02020848f;
-            bestparams.distance1 = 0.95966351f;
-            bestparams.distance2 = 1.51834857f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
+            scores[0] = evaluate(candidates[0], search->Bound(0), search->Cache(0));
         }
-    }
-
-    else if (strcmp(chip, "8580_5092") == 0)
-    {
-        is8580 = true;
-
-        switch (wave)
+        else
         {
-        case 3: // ST
-            // current score 1167 (130/32768) [RMS: 53.74]
-            bestparams.threshold = 0.812157929f;
-            bestparams.topbit = 1.19008696f;
-            bestparams.distance1 = 1.8724792f;
-            bestparams.distance2 = 2.3072772f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 4773 (132/32768) [RMS: 112.70]
-            bestparams.threshold = 0.979222834f;
-            bestparams.pulsestrength = 1.15944064f;
-            bestparams.distance1 = 1.06649458f;
-            bestparams.distance2 = 1.58736694f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 9499 (349/32768) [RMS: 105.77]
-            bestparams.threshold = 0.967251718f;
-            bestparams.pulsestrength = 1.20654142f;
-            bestparams.topbit = 0.966849685f;
-            bestparams.distance1 = 0.00760078849f;
-            bestparams.distance2 = 0.314019769f;
-            bestparams.distFunc = Parameters::quadraticDistance;
-            break;
-        case 7: // PST
-            // current score 10131 (133/32768) [RMS: 62.78]
-            bestparams.threshold = 1.06831551f;
-            bestparams.pulsestrength = 0.120533176f;
-            bestparams.topbit = 1.20669949f;
-            bestparams.distance1 = 1.95325541f;
-            bestparams.distance2 = 6.4570384f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
+            #pragma omp parallel for schedule(dynamic)
+            for (int n = 0; n < static_cast<int>(candidates.size()); n++)
+            {
+                scores[n] = evaluate(candidates[n], search->Bound(n), search->Cache(n));
+            }
         }
-    }
-
-    else if (strcmp(chip, "8580_0590") == 0)
-    {
-        is8580 = true;
+        evaluations += candidates.size();
 
-        switch (wave)
+        unsigned int round = 0;
+        for (unsigned int n = 0; n < candidates.size(); n++)
         {
-        case 3: // ST
-            // current score 2143 (187/32768) [RMS: 55.31]
-            bestparams.threshold = 0.688183069f;
-            bestparams.topbit = 0.929571509f;
-            bestparams.distance1 = 1.21250761f;
-            bestparams.distance2 = 2.13566232f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 8480 (213/32768) [RMS: 108.31]
-            bestparams.threshold = 0.955921412f;
-            bestparams.pulsestrength = 1.13047683f;
-            bestparams.distance1 = 1.09507132f;
-            bestparams.distance2 = 1.51376963f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 10803 (451/32768) [RMS: 103.87]
-            bestparams.threshold = 0.924851418f;
-            bestparams.pulsestrength = 1.08761322f;
-            bestparams.topbit = 0.975993514f;
-            bestparams.distance1 = 0.0001295088f;
-            bestparams.distance2 = 0.285822004f;
-            bestparams.distFunc = Parameters::quadraticDistance;
-            break;
-        case 7: // PST
-            // current score 7247 (117/32768) [RMS: 54.34]
-            bestparams.threshold = 0.897638917f;
-            bestparams.pulsestrength = 0.602467358f;
-            bestparams.topbit = 1.01111174f;
-            bestparams.distance1 = 1.12252307f;
-            bestparams.distance2 = 1.67404807f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
+            stats.Add(search->Mutated(n), scores[n], bestscore);
+            if (scores[round].isBetter(scores[n]))
+                round = n;
         }
-    }
 
-    else if (strcmp(chip, "8580_1087") == 0)
-    {
-        is8580 = true;
+        // print the rate of wrong bits, without flushing as ties can be very frequent
+        if (!options.quiet && !bestscore.isBetter(scores[round])
+            && (scores[round].audible_error == bestscore.audible_error))
+            out << GetWrongBitsRate(scores[round]) << '\n';
 
-        switch (wave)
+        search->Tell(scores);
+
+        const unsigned int best = search->Best();
+        if (bestscore.isBetter(search->MemberScore(best)))
         {
-        case 3: // ST
-            // current score 1615 (134/32768) [RMS: 53.79]
-            bestparams.threshold = 0.791922331f;
-            bestparams.topbit = 1.27795017f;
-            bestparams.distance1 = 1.77714765f;
-            bestparams.distance2 = 2.21664143f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 7898 (162/32768) [RMS: 94.81]
-            bestparams.threshold = 0.9482705f;
-            bestparams.pulsestrength = 1.21793139f;
-            bestparams.distance1 = 1.04166055f;
-            bestparams.distance2 = 1.37272894f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 9804 (337/32768) [RMS: 89.58]
-            bestparams.threshold = 0.954935849f;
-            bestparams.pulsestrength = 1.28759611f;
-            bestparams.topbit = 1.00321376f;
-            bestparams.distance1 = 0.000331178948f;
-            bestparams.distance2 = 0.151375741f;
-            bestparams.distFunc = Parameters::quadraticDistance;
-            break;
-        case 7: // PST
-            // current score 3184 (55/32768) [RMS: 47.77]
-            bestparams.threshold = 0.949159145f;
-            bestparams.pulsestrength = 0.894956648f;
-            bestparams.topbit = 1.06276321f;
-            bestparams.distance1 = 1.06268573f;
-            bestparams.distance2 = 1.47704351f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
+            bestparams = search->Member(best);
+            bestscore = search->MemberScore(best);
+            out << "# current score " << std::dec
+                << bestscore << std::endl
+                << ToString(bestparams) << std::endl << std::endl;
+
+            lastImprovement = evaluations;
+            lastImprovementTime = elapsed();
+            if (options.adaptiveOrder)
+                order = bestparams.GetSampleOrder(wave, reference);
+            improved(bestparams, bestscore);
+            reportDistance();
         }
     }
 
-    else if (strcmp(chip, "8580_1088") == 0)
-    {
-        is8580 = true;
+    if (checkpoint)
+        save();
 
-        switch (wave)
-        {
-        case 3: // ST
-            // current score 10660 (353/32768) [RMS: 58.34]
-            bestparams.threshold = 0.853578329f;
-            bestparams.topbit = 1.09615636f;
-            bestparams.distance1 = 1.8819375f;
-            bestparams.distance2 = 6.80794907f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 10635 (289/32768) [RMS: 108.81]
-            bestparams.threshold = 0.929835618f;
-            bestparams.pulsestrength = 1.12836814f;
-            bestparams.distance1 = 1.10453653f;
-            bestparams.distance2 = 1.48065746f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 12255 (554/32768) [RMS: 102.27]
-            bestparams.threshold = 0.911938608f;
-            bestparams.pulsestrength = 1.2278074f;
-            bestparams.topbit = 0.996440411f;
-            bestparams.distance1 = 0.000117214302f;
-            bestparams.distance2 = 0.18948476f;
-            bestparams.distFunc = Parameters::quadraticDistance;
-            break;
-        case 7: // PST
-            // current score 6913 (127/32768) [RMS: 55.80]
-            bestparams.threshold = 0.938004673f;
-            bestparams.pulsestrength = 1.21178246f;
-            bestparams.topbit = 1.04827631f;
-            bestparams.distance1 = 0.915959001f;
-            bestparams.distance2 = 1.42698038f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        }
-    }
+    if (report)
+        publish();
 
-    else if (strcmp(chip, "8580_1489") == 0)
-    {
-        is8580 = true;
+    result_t result;
+    result.params = bestparams;
+    result.score = bestscore;
+    result.evaluations = evaluations;
+    result.seconds = elapsed();
+    result.ok = true;
+    return result;
+}
 
-        switch (wave)
-        {
-        case 3: // ST
-            // current score 4837 (388/32768) [RMS: 76.07]
-            bestparams.threshold = 0.89762634f;
-            bestparams.topbit = 56.7594185f;
-            bestparams.distance1 = 7.68995237f;
-            bestparams.distance2 = 12.0754194f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 9266 (508/32768) [RMS: 127.83]
-            bestparams.threshold = 0.87147671f;
-            bestparams.pulsestrength = 1.44887495f;
-            bestparams.distance1 = 1.05899632f;
-            bestparams.distance2 = 1.43786001f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 13168 (718/32768) [RMS: 123.35]
-            bestparams.threshold = 0.89255774f;
-            bestparams.pulsestrength = 1.75615835f;
-            bestparams.topbit = 1.2253896f;
-            bestparams.distance1 = 0.0245045591f;
-            bestparams.distance2 = 0.12982437f;
-            bestparams.distFunc = Parameters::quadraticDistance;
-            break;
-        case 7: // PST
-            // current score 6702 (300/32768) [RMS: 71.01]
-            bestparams.threshold = 0.91124934f;
-            bestparams.pulsestrength = 0.909965038f;
-            bestparams.topbit = 0.963609755f;
-            bestparams.distance1 = 1.07445884f;
-            bestparams.distance2 = 1.82399702f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        }
+/**
+ * Split a file into lines.
+ */
+static std::vector<std::string> split(const std::string &s, char delim)
+{
+    std::vector<std::string> elems;
+    std::istringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, delim))
+    {
+        elems.push_back(item);
     }
+    return elems;
+}
 
-    else if (strcmp(chip, "8580_1891") == 0)
-    {
-        is8580 = true;
+/**
+ * Parse a whole decimal number between min and max.
+ *
+ * @return false if the string is not a number or it's out of range
+ */
+static bool ParseRange(const char* s, long min, long max, unsigned int &value)
+{
+    char* end;
+    errno = 0;
+    const long n = strtol(s, &end, 10);
+    if ((end == s) || *end || errno || (n < min) || (n > max))
+        return false;
+    value = n;
+    return true;
+}
 
-        switch (wave)
-        {
-        case 3: // ST
-            // current score 3401 (283/32768) [RMS: 65.87]
-            bestparams.threshold = 0.74335587f;
-            bestparams.topbit = 1.13261592f;
-            bestparams.distance1 = 1.83344603f;
-            bestparams.distance2 = 3.90392399f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 9242 (255/32768) [RMS: 107.70]
-            bestparams.threshold = 0.924806535f;
-            bestparams.pulsestrength = 1.20028079f;
-            bestparams.distance1 = 1.07056773f;
-            bestparams.distance2 = 1.43234241f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 13940 (609/32768) [RMS: 103.25]
-            bestparams.threshold = 0.901862085f;
-            bestparams.pulsestrength = 1.11271441f;
-            bestparams.topbit = 1.02348149f;
-            bestparams.distance1 = 0.000376841635f;
-            bestparams.distance2 = 0.220544845f;
-            bestparams.distFunc = Parameters::quadraticDistance;
-            break;
-        case 7: // PST
-            // current score 8423 (181/32768) [RMS: 54.39]
-            bestparams.threshold = 0.987342596f;
-            bestparams.pulsestrength = 0.215089902f;
-            bestparams.topbit = 0.995823205f;
-            bestparams.distance1 = 0.78425771f;
-            bestparams.distance2 = 2.62625265f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        }
-    }
+/**
+ * Open the corpus of sampled data making sure it contains
+ * all the known chips plus the given ones.
+ */
+static void OpenCorpus(Corpus &corpus, const std::vector<const char*> &extra)
+{
+    std::vector<std::string> names(std::begin(chips), std::end(chips));
+    names.insert(names.end(), extra.begin(), extra.end());
+    if (!corpus.Open(names))
+        exit(EXIT_FAILURE);
+}
+
+/**
+ * Get sampled values for specific waveform and chip.
+ */
+static ref_vector_t GetReference(const Corpus &corpus, int wave, const char* chip)
+{
+    const uint8_t* samples = corpus.Get(corpus.Find(chip), wave);
+    return ref_vector_t(samples, samples + Corpus::SAMPLES);
+}
+
+/**
+ * Get the function writing the statistics of a fit to out, if any.
+ *
+ * @param lock serializes the writes of concurrent fits
+ * @param start the statistics of the runs the fit resumes from
+ */
+static std::function<void(const fit_stats_t&)> GetReporter(std::ostream *out, std::mutex &lock,
+                                                           const char* chip, int wave,
+                                                           const fit_stats_t &start = fit_stats_t())
+{
+    if (!out)
+        return nullptr;
 
-    else if (strcmp(chip, "8580_3190") == 0)
+    fit_stats_t previous = start;
+    return [out, &lock, chip, wave, previous](const fit_stats_t &stats) mutable
     {
-        is8580 = true;
+        std::lock_guard<std::mutex> guard(lock);
+        WriteStatsJson(stats, previous, chip, wave, *out);
+        previous = stats;
+    };
+}
 
-        switch (wave)
-        {
-        case 3: // ST
-            // current score 2593 (269/32768) [RMS: 67.29]
-            bestparams.threshold = 0.742079914f;
-            bestparams.topbit = 1.16795468f;
-            bestparams.distance1 = 1.82698667f;
-            bestparams.distance2 = 3.90259051f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 7136 (302/32768) [RMS: 115.07]
-            bestparams.threshold = 0.920148611f;
-            bestparams.pulsestrength = 1.2706455f;
-            bestparams.distance1 = 1.03514659f;
-            bestparams.distance2 = 1.45814693f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 14360 (668/32768) [RMS: 109.45]
-            bestparams.threshold = 0.911647439f;
-            bestparams.pulsestrength = 1.19287789f;
-            bestparams.topbit = 1.00216305f;
-            bestparams.distance1 = 0.000113861912f;
-            bestparams.distance2 = 0.257546455f;
-            bestparams.distFunc = Parameters::quadraticDistance;
-            break;
-        case 7: // PST
-            // current score 8600 (135/32768) [RMS: 62.31]
-            bestparams.threshold = 0.943421066f;
-            bestparams.pulsestrength = 1.19525087f;
-            bestparams.topbit = 1.0747292f;
-            bestparams.distance1 = 0.970244825f;
-            bestparams.distance2 = 1.48792744f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        }
-    }
+/**
+ * Fit all the combinations of chips and waveforms,
+ * writing one line of results for each of them.
+ */
+static void Batch(ParamStore &store, const std::vector<const char*> &chipList, const std::vector<int> &waves,
+                  const options_t &options, bool warmStart, std::ostream &out, std::ostream *stats)
+{
+    Corpus corpus;
+    OpenCorpus(corpus, chipList);
 
-    else if (strcmp(chip, "8580_3491") == 0)
+    std::vector<std::unique_ptr<ChipClusters>> clusters(8);
+    if (warmStart)
     {
-        is8580 = true;
+        for (int wave: waves)
+            clusters[wave].reset(new ChipClusters(corpus, wave));
+    }
 
-        switch (wave)
+    struct job_t
+    {
+        const char* chip;
+        int wave;
+        ref_vector_t reference;
+        Parameters initial;
+        bool is8580;
+        bool known;
+    };
+
+    // the initial parameters are all taken before any fit updates the store,
+    // so the warm starts, and the results, don't depend on the scheduling
+    std::vector<job_t> jobs;
+    for (const char* chip: chipList)
+    {
+        for (int wave: waves)
         {
-        case 3: // ST
-            // current score 1935 (229/32768) [RMS: 58.48]
-            bestparams.threshold = 0.720933437f;
-            bestparams.topbit = 0.997237265f;
-            bestparams.distance1 = 1.59829557f;
-            bestparams.distance2 = 3.3607018f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 8480 (236/32768) [RMS: 103.09]
-            bestparams.threshold = 0.924642026f;
-            bestparams.pulsestrength = 1.19979942f;
-            bestparams.distance1 = 1.07368398f;
-            bestparams.distance2 = 1.39958048f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 12414 (523/32768) [RMS: 98.70]
-            bestparams.threshold = 0.922902048f;
-            bestparams.pulsestrength = 1.24408174f;
-            bestparams.topbit = 1.07340896f;
-            bestparams.distance1 = 0.000197364454f;
-            bestparams.distance2 = 0.16440165f;
-            bestparams.distFunc = Parameters::quadraticDistance;
-            break;
-        case 7: // PST
-            // current score 3808 (88/32768) [RMS: 51.22]
-            bestparams.threshold = 0.96112895f;
-            bestparams.pulsestrength = 1.36136329f;
-            bestparams.topbit = 1.13906264f;
-            bestparams.distance1 = 0.971457958f;
-            bestparams.distance2 = 1.35724473f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
+            job_t job = { chip, wave, GetReference(corpus, wave, chip), Parameters(), false, false };
+
+            // unknown chips start from the parameters of the related ones, or the defaults
+            job.known = GetInitialParams(store, chip, wave, job.initial, job.is8580);
+            std::string from;
+            if (!job.known && warmStart)
+                GetWarmStart(store, corpus, *clusters[wave], chip, wave, job.reference, job.initial, job.is8580, from);
+            jobs.push_back(job);
         }
     }
 
-    else if (strcmp(chip, "8580_3987") == 0)
+    out << "chip,wave,audible_error,wrong_bits,rms,distance,threshold,pulsestrength,topbit,distance1,distance2,evaluations,seconds"
+        << std::endl;
+
+    std::mutex lock;
+    std::mutex statsLock;
+    Scheduler scheduler(jobs.size());
+    scheduler.Run([&](unsigned int i)
     {
-        is8580 = true;
+        const job_t &job = jobs[i];
+
+        std::ostringstream line;
+        line << job.chip << "," << job.wave << ",";
+
+        const bool is8580 = job.is8580;
+
+        // each fit has its own seed, so the results don't depend on the scheduling
+        options_t jobOptions = options;
+        jobOptions.seed = DeriveSeed(options.seed, i);
+
+        // discard the progress of each fit
+        std::ostream quiet(nullptr);
+        const result_t result = Optimize(job.reference, job.wave, job.initial, is8580, jobOptions, quiet,
+            [&](const Parameters &p, const score_t &score)
+            {
+                if (store.Update(job.chip, job.wave, is8580, p,
+                                 GetStoredScore(p, score, job.wave, is8580, job.reference)))
+                    store.Save(false);
+            },
+            GetReporter(stats, statsLock, job.chip, job.wave));
+        if (!result.ok)
+            return;
+        if (!job.known)
+            store.Update(job.chip, job.wave, is8580, result.params,
+                         GetStoredScore(result.params, result.score, job.wave, is8580, job.reference));
+
+        line.precision(2);
+        line << result.score.audible_error << ","
+             << result.score.wrong_bits << ","
+             << std::fixed << result.score.rms << ",";
+        line.unsetf(std::ios_base::floatfield);
+        line.precision(flt::max_digits10);
+        line << GetDistanceName(result.params.distFunc) << ","
+             << result.params.threshold << ","
+             << result.params.pulsestrength << ","
+             << result.params.topbit << ","
+             << result.params.distance1 << ","
+             << result.params.distance2 << ","
+             << result.evaluations << ","
+             << result.seconds;
+
+        std::lock_guard<std::mutex> guard(lock);
+        out << line.str() << std::endl;
+    });
+
+    if (!store.Save())
+        std::cout << "Error saving the parameter store" << std::endl;
+}
 
-        switch (wave)
+/**
+ * Export the combined waveform tables generated from the best parameters
+ * of the chip, as a C++ header if the file name ends in .h
+ * or as a binary blob otherwise.
+ *
+ * @param cacheDir if not null the tables are taken from the table cache in this directory,
+ *                 which generates only the missing ones
+ */
+static void Export(const ParamStore &store, const char* file, const char* chip, bool analog, const char* cacheDir)
+{
+    Parameters params[tables_t::WAVES];
+    for (unsigned int w = 0; w < tables_t::WAVES; w++)
+    {
+        bool is8580;
+        if (!GetInitialParams(store, chip, tables_t::wave[w], params[w], is8580))
         {
-        case 3: // ST
-            // current score 2029 (283/32768) [RMS: 57.53]
-            bestparams.threshold = 0.705426931f;
-            bestparams.topbit = 0.92870903f;
-            bestparams.distance1 = 1.47875774f;
-            bestparams.distance2 = 3.15420222f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 9212 (287/32768) [RMS: 101.67]
-            bestparams.threshold = 0.903500497f;
-            bestparams.pulsestrength = 1.02719498f;
-            bestparams.distance1 = 1.06971335f;
-            bestparams.distance2 = 1.4370302f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 11109 (503/32768) [RMS: 96.46]
-            bestparams.threshold = 0.933880389f;
-            bestparams.pulsestrength = 1.29445052f;
-            bestparams.topbit = 1.06563056f;
-            bestparams.distance1 = 0.000236776366f;
-            bestparams.distance2 = 0.152991742f;
-            bestparams.distFunc = Parameters::quadraticDistance;
-            break;
-        case 7: // PST
-            // current score 5112 (140/32768) [RMS: 50.95]
-            bestparams.threshold = 0.866591275f;
-            bestparams.pulsestrength = 0.113579206f;
-            bestparams.topbit = 0.877181113f;
-            bestparams.distance1 = 1.1728934f;
-            bestparams.distance2 = 2.75143433f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
+            std::cout << "Unrecognized chip" << std::endl;
+            exit(EXIT_FAILURE);
         }
     }
 
-    else if (strcmp(chip, "8580_4388") == 0)
+    std::unique_ptr<tables_t> tables;
+    if (cacheDir)
     {
-        is8580 = true;
-
-        switch (wave)
-        {
-        case 3: // ST
-            // current score 2274 (288/32768) [RMS: 57.79]
-            bestparams.threshold = 0.727870882f;
-            bestparams.topbit = 0.981630623f;
-            bestparams.distance1 = 1.62720287f;
-            bestparams.distance2 = 3.45849872f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 7433 (192/32768) [RMS: 90.72]
-            bestparams.threshold = 0.946936846f;
-            bestparams.pulsestrength = 1.29151738f;
-            bestparams.distance1 = 1.08113289f;
-            bestparams.distance2 = 1.32524669f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 14028 (521/32768) [RMS: 87.97]
-            bestparams.threshold = 0.973695457f;
-            bestparams.pulsestrength = 1.51140547f;
-            bestparams.topbit = 1.06569493f;
-            bestparams.distance1 = 0.0182949118f;
-            bestparams.distance2 = 0.109501146f;
-            bestparams.distFunc = Parameters::quadraticDistance;
-            break;
-        case 7: // PST
-            // current score 5198 (86/32768) [RMS: 45.73]
-            bestparams.threshold = 0.992993474f;
-            bestparams.pulsestrength = 1.39050341f;
-            bestparams.topbit = 1.10221159f;
-            bestparams.distance1 = 0.909341216f;
-            bestparams.distance2 = 1.34693623f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        }
+        tables.reset(new tables_t(analog));
+        TableCache(cacheDir).GetTables(params, *tables);
+    }
+    else
+    {
+        tables.reset(new tables_t(params, analog));
     }
 
-    else if (strcmp(chip, "8580_4589") == 0)
+    const size_t len = strlen(file);
+    const bool header = (len > 2) && (strcmp(file + len - 2, ".h") == 0);
+
+    std::ofstream ofs(file, header ? std::ofstream::out : std::ofstream::binary);
+    if (!ofs.is_open())
     {
-        is8580 = true;
+        std::cout << "Error opening file " << file << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (header)
+        WriteTablesHeader(*tables, chip, ofs);
+    else
+        WriteTablesBinary(*tables, ofs);
+}
 
-        switch (wave)
+static void Usage(const char* name)
+{
+    std::cout << "Usage " << name << " [options] <waveform> <chip>" << std::endl
+              << "      " << name << " [options] --batch [<chip>...]" << std::endl
+              << "      " << name << " [--analog] [--table-cache <dir>] --export <file> <chip>" << std::endl
+              << "Options:" << std::endl
+              << "  --strategy <name> search with mc, the Monte Carlo random walk (default)," << std::endl
+              << "                    de, differential evolution, or chains, Monte Carlo chains" << std::endl
+              << "                    with different mutation widths" << std::endl
+              << "  --chains <n>      number of chains (default the number of threads)" << std::endl
+              << "  --all-distances   search also the best distance function" << std::endl
+              << "  --population <n>  evaluate n candidates concurrently at each step" << std::endl
+              << "  --adaptive-order  score first the values with the largest errors" << std::endl
+              << "  --engine <name>   score with the float model (default) or its fixed point approximation" << std::endl
+              << "  --time <seconds>  stop after the given time" << std::endl
+              << "  --evaluations <n> stop after n evaluations" << std::endl
+              << "  --stall <n>       stop after n evaluations without improvement" << std::endl
+              << "  --target <error>  stop when the audible error reaches the target (default 0)" << std::endl
+              << "  --batch           fit all the given chips, or all the known ones" << std::endl
+              << "  --waves <list>    waveforms fitted in batch mode (default 3567)" << std::endl
+              << "  --output <file>   write the batch results to file" << std::endl
+              << "  --export <file>   write the combined waveform tables, as a header if file ends in .h" << std::endl
+              << "  --analog          export also the 12 bit analog tables" << std::endl
+              << "  --table-cache <dir>  export the tables through the table cache in dir," << std::endl
+              << "                    generating only the ones not already there" << std::endl
+              << "  --seed <n>        seed of the random generators, for reproducible runs (default random)" << std::endl
+              << "  --cold-start      start unknown chips from the defaults instead of the parameters" << std::endl
+              << "                    of the nearest cluster of similar chips" << std::endl
+              << "  --params <file>   the parameter store (default " << ParamStore::DEFAULT_FILE << ")" << std::endl
+              << "  --checkpoint <file>   save the state of the fit to file, and resume from it if present" << std::endl
+              << "  --checkpoint-interval <seconds>  time between checkpoints (default 60)" << std::endl
+              << "  --stats <file>    write the statistics of the fit to file, as JSON lines" << std::endl
+              << "  --stats-interval <seconds>  time between statistics reports (default 10)" << std::endl
+              << "  --quiet           print only the improvements" << std::endl
+              << "  --dump <file>     write the comparison with the reference to file, as CSV or binary" << std::endl
+              << "                    if it ends in .csv or .bin" << std::endl
+              << "  --sweep <p>,<q>   start from the best point of a coarse to fine grid sweep of two parameters," << std::endl
+              << "                    always scored with the float model, skipped when resuming a checkpoint" << std::endl
+              << "  --grid <n>        points per side of the sweep grid, from 3 to 257 (default 17)" << std::endl
+              << "  --levels <n>      refinements of the sweep, from 1 to 16 (default 3)" << std::endl
+              << "  --sweep-range <r> the first grid spans from 1/r to r times the initial values (default 4)" << std::endl
+              << "  --landscape <file>  write the swept points to file, as binary if it ends in .bin or CSV" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, const char* argv[])
+{
+    options_t options;
+    bool batch = false;
+    std::vector<int> waves = { 3, 5, 6, 7 };
+    const char* output = nullptr;
+    const char* exportFile = nullptr;
+    bool analog = false;
+    const char* tableCache = nullptr;
+    const char* paramsFile = ParamStore::DEFAULT_FILE;
+    const char* statsFile = nullptr;
+    Parameters::engine_t engine = Parameters::engine_t::FLOAT;
+    const char* sweep = nullptr;
+    unsigned int grid = 17;
+    unsigned int levels = 3;
+    double sweepRange = 4.;
+    const char* landscape = nullptr;
+    bool warmStart = true;
+    bool seeded = false;
+
+    int arg = 1;
+    for (; (arg < argc) && (argv[arg][0] == '-'); arg++)
+    {
+        if ((strcmp(argv[arg], "--population") == 0) && (arg + 1 < argc))
+        {
+            options.population = atoi(argv[++arg]);
+        }
+        else if ((strcmp(argv[arg], "--engine") == 0) && (arg + 1 < argc))
+        {
+            const char* name = argv[++arg];
+            if (strcmp(name, "float") == 0)
+                engine = Parameters::engine_t::FLOAT;
+            else if (strcmp(name, "fixed") == 0)
+                engine = Parameters::engine_t::FIXED;
+            else
+                Usage(argv[0]);
+        }
+        else if (strcmp(argv[arg], "--all-distances") == 0)
+        {
+            options.distances = true;
+        }
+        else if ((strcmp(argv[arg], "--seed") == 0) && (arg + 1 < argc))
+        {
+            options.seed = strtoull(argv[++arg], nullptr, 10);
+            seeded = true;
+        }
+        else if (strcmp(argv[arg], "--cold-start") == 0)
+        {
+            warmStart = false;
+        }
+        else if ((strcmp(argv[arg], "--chains") == 0) && (arg + 1 < argc))
+        {
+            options.chains = atoi(argv[++arg]);
+        }
+        else if ((strcmp(argv[arg], "--strategy") == 0) && (arg + 1 < argc))
+        {
+            const char* strategy = argv[++arg];
+            if (strcmp(strategy, "mc") == 0)
+                options.strategy = strategy_t::MONTE_CARLO;
+            else if (strcmp(strategy, "de") == 0)
+                options.strategy = strategy_t::DIFFERENTIAL_EVOLUTION;
+            else if (strcmp(strategy, "chains") == 0)
+                options.strategy = strategy_t::CHAINS;
+            else
+                Usage(argv[0]);
+        }
+        else if (strcmp(argv[arg], "--adaptive-order") == 0)
+        {
+            options.adaptiveOrder = true;
+        }
+        else if ((strcmp(argv[arg], "--time") == 0) && (arg + 1 < argc))
+        {
+            options.stop.seconds = atof(argv[++arg]);
+        }
+        else if ((strcmp(argv[arg], "--evaluations") == 0) && (arg + 1 < argc))
+        {
+            options.stop.evaluations = strtoul(argv[++arg], nullptr, 10);
+        }
+        else if ((strcmp(argv[arg], "--stall") == 0) && (arg + 1 < argc))
+        {
+            options.stop.stall = strtoul(argv[++arg], nullptr, 10);
+        }
+        else if ((strcmp(argv[arg], "--target") == 0) && (arg + 1 < argc))
+        {
+            options.stop.target = strtoul(argv[++arg], nullptr, 10);
+        }
+        else if (strcmp(argv[arg], "--batch") == 0)
+        {
+            batch = true;
+        }
+        else if ((strcmp(argv[arg], "--waves") == 0) && (arg + 1 < argc))
+        {
+            waves.clear();
+            for (const char* c = argv[++arg]; *c; c++)
+            {
+                const int wave = *c - '0';
+                if (wave != 3 && wave != 5 && wave != 6 && wave != 7)
+                    Usage(argv[0]);
+                waves.push_back(wave);
+            }
+        }
+        else if ((strcmp(argv[arg], "--output") == 0) && (arg + 1 < argc))
+        {
+            output = argv[++arg];
+        }
+        else if ((strcmp(argv[arg], "--export") == 0) && (arg + 1 < argc))
+        {
+            exportFile = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--analog") == 0)
+        {
+            analog = true;
+        }
+        else if ((strcmp(argv[arg], "--table-cache") == 0) && (arg + 1 < argc))
+        {
+            tableCache = argv[++arg];
+        }
+        else if ((strcmp(argv[arg], "--params") == 0) && (arg + 1 < argc))
+        {
+            paramsFile = argv[++arg];
+        }
+        else if ((strcmp(argv[arg], "--checkpoint") == 0) && (arg + 1 < argc))
+        {
+            options.checkpoint = argv[++arg];
+        }
+        else if ((strcmp(argv[arg], "--checkpoint-interval") == 0) && (arg + 1 < argc))
+        {
+            options.checkpointInterval = atof(argv[++arg]);
+        }
+        else if ((strcmp(argv[arg], "--stats") == 0) && (arg + 1 < argc))
+        {
+            statsFile = argv[++arg];
+        }
+        else if ((strcmp(argv[arg], "--stats-interval") == 0) && (arg + 1 < argc))
+        {
+            options.statsInterval = atof(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "--quiet") == 0)
+        {
+            options.quiet = true;
+        }
+        else if ((strcmp(argv[arg], "--dump") == 0) && (arg + 1 < argc))
+        {
+            options.dumpFile = argv[++arg];
+        }
+        else if ((strcmp(argv[arg], "--sweep") == 0) && (arg + 1 < argc))
+        {
+            sweep = argv[++arg];
+        }
+        else if ((strcmp(argv[arg], "--grid") == 0) && (arg + 1 < argc))
+        {
+            if (!ParseRange(argv[++arg], GridSweep::MIN_SIZE, GridSweep::MAX_SIZE, grid))
+                Usage(argv[0]);
+        }
+        else if ((strcmp(argv[arg], "--levels") == 0) && (arg + 1 < argc))
+        {
+            if (!ParseRange(argv[++arg], 1, GridSweep::MAX_LEVELS, levels))
+                Usage(argv[0]);
+        }
+        else if ((strcmp(argv[arg], "--sweep-range") == 0) && (arg + 1 < argc))
+        {
+            sweepRange = atof(argv[++arg]);
+        }
+        else if ((strcmp(argv[arg], "--landscape") == 0) && (arg + 1 < argc))
+        {
+            landscape = argv[++arg];
+        }
+        else
         {
-        case 3: // ST
-            // current score 12084 (360/32768) [RMS: 58.90]
-            bestparams.threshold = 0.711074412f;
-            bestparams.topbit = 0.947770417f;
-            bestparams.distance1 = 1.55405724f;
-            bestparams.distance2 = 3.37904644f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 7797 (249/32768) [RMS: 106.71]
-            bestparams.threshold = 0.923860133f;
-            bestparams.pulsestrength = 1.2507503f;
-            bestparams.distance1 = 1.05845523f;
-            bestparams.distance2 = 1.40350294f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 14873 (637/32768) [RMS: 102.11]
-            bestparams.threshold = 0.920532703f;
-            bestparams.pulsestrength = 1.22037268f;
-            bestparams.topbit = 1.04574573f;
-            bestparams.distance1 = 0.0102976905f;
-            bestparams.distance2 = 0.192607388f;
-            bestparams.distFunc = Parameters::quadraticDistance;
-            break;
-        case 7: // PST
-            // current score 9803 (220/32768) [RMS: 56.34]
-            bestparams.threshold = 0.882457912f;
-            bestparams.pulsestrength = 0.0400544927f;
-            bestparams.topbit = 0.932223499f;
-            bestparams.distance1 = 1.36063206f;
-            bestparams.distance2 = 4.08809948f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
+            Usage(argv[0]);
         }
     }
 
-    else if (strcmp(chip, "8580_4790") == 0)
-    {
-        is8580 = true;
+    if (!seeded)
+        options.seed = getSeed();
+
+    ParamStore store;
+    if (!store.Load(paramsFile))
+        exit(EXIT_FAILURE);
 
-        switch (wave)
+    std::ofstream statsStream;
+    std::ostream *statsOut = nullptr;
+    std::mutex statsLock;
+    if (statsFile)
+    {
+        statsStream.open(statsFile);
+        if (!statsStream.is_open())
         {
-        case 3: // ST
-            // current score 1920 (242/32768) [RMS: 57.04]
-            bestparams.threshold = 0.725565016f;
-            bestparams.topbit = 0.995874524f;
-            bestparams.distance1 = 1.61511159f;
-            bestparams.distance2 = 3.41737127f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 8512 (236/32768) [RMS: 100.71]
-            bestparams.threshold = 0.921056628f;
-            bestparams.pulsestrength = 1.1018368f;
-            bestparams.distance1 = 1.07269633f;
-            bestparams.distance2 = 1.42056799f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 10298 (429/32768) [RMS: 95.11]
-            bestparams.threshold = 0.947014332f;
-            bestparams.pulsestrength = 1.24134386f;
-            bestparams.topbit = 1.04770589f;
-            bestparams.distance1 = 0.0143143889f;
-            bestparams.distance2 = 0.175531596f;
-            bestparams.distFunc = Parameters::quadraticDistance;
-            break;
-        case 7: // PST
-            // current score 4026 (133/32768) [RMS: 51.13]
-            bestparams.threshold = 0.829947531f;
-            bestparams.pulsestrength = 0.383184969f;
-            bestparams.topbit = 0.859575093f;
-            bestparams.distance1 = 1.12513435f;
-            bestparams.distance2 = 1.78050268f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
+            std::cout << "Error opening file " << statsFile << std::endl;
+            exit(EXIT_FAILURE);
         }
+        statsOut = &statsStream;
     }
 
-    else if (strcmp(chip, "8580_4887") == 0)
+    if (exportFile)
     {
-        is8580 = true;
-
-        switch (wave)
+        if (argc - arg != 1)
         {
-        case 3: // ST
-            // current score score 741 (76/32768) [RMS: 53.74]
-            bestparams.threshold = 0.812351167f;
-            bestparams.topbit = 1.1727736f;
-            bestparams.distance1 = 1.87459648f;
-            bestparams.distance2 = 2.31578159f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 7199 (192/32768) [RMS: 88.43]
-            bestparams.threshold = 0.917997837f;
-            bestparams.pulsestrength = 1.01248944f;
-            bestparams.distance1 = 1.05761552f;
-            bestparams.distance2 = 1.37529826f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 9856 (332/32768) [RMS: 86.29]
-            bestparams.threshold = 0.968754232f;
-            bestparams.pulsestrength = 1.29909098f;
-            bestparams.topbit = 1.00669801f;
-            bestparams.distance1 = 0.00962483883f;
-            bestparams.distance2 = 0.146850556f;
-            bestparams.distFunc = Parameters::quadraticDistance;
-            break;
-        case 7: // PST
-            // current score 4809 (60/32768) [RMS: 45.37]
-            bestparams.threshold = 0.941834152f;
-            bestparams.pulsestrength = 0.991132736f;
-            bestparams.topbit = 1.06401193f;
-            bestparams.distance1 = 0.995310068f;
-            bestparams.distance2 = 1.41105855f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
+            Usage(argv[0]);
         }
+        Export(store, exportFile, argv[arg], analog, tableCache);
+        exit(EXIT_SUCCESS);
     }
 
-    else if (strcmp(chip, "8580_5092_2") == 0)
+    // the exported tables always come from the floating point model
+    Parameters::UseEngine(engine);
+
+    if (batch)
     {
-        is8580 = true;
+        if (!options.stop.isBounded())
+        {
+            std::cout << "Batch mode requires a time or evaluation budget" << std::endl;
+            exit(EXIT_FAILURE);
+        }
 
-        switch (wave)
+        if (options.checkpoint)
         {
-        case 3: // ST
-            // current score 1359 (150/32768) [RMS: 55.11]
-            bestparams.threshold = 0.841939628f;
-            bestparams.topbit = 1.1484369f;
-            bestparams.distance1 = 1.66275322f;
-            bestparams.distance2 = 4.84815454f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 5: // PT
-            // current score 5211 (232/32768) [RMS: 110.48]
-            bestparams.threshold = 0.929421425f;
-            bestparams.pulsestrength = 1.12068617f;
-            bestparams.distance1 = 1.04392564f;
-            bestparams.distance2 = 1.50432301f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
-        case 6: // PS
-            // current score 11563 (455/32768) [RMS: 103.00]
-            bestparams.threshold = 0.926378012f;
-            bestparams.pulsestrength = 0.933422148f;
-            bestparams.topbit = 0.984673321f;
-            bestparams.distance1 = 0.0299169403f;
-            bestparams.distance2 = 0.384482265f;
-            bestparams.distFunc = Parameters::quadraticDistance;
-            break;
-        case 7: // PST
-            // current score 6693 (63/32768) [RMS: 57.93]
-            bestparams.threshold = 0.955013871f;
-            bestparams.pulsestrength = 1.03108287f;
-            bestparams.topbit = 1.1251868f;
-            bestparams.distance1 = 1.02317023f;
-            bestparams.distance2 = 1.50494277f;
-            bestparams.distFunc = Parameters::exponentialDistance;
-            break;
+            std::cout << "Checkpoints are not supported in batch mode" << std::endl;
+            exit(EXIT_FAILURE);
         }
-    }
 
-    else if (strcmp(chip, "broken0384") == 0)
-    {
-        switch (wave)
+        if (sweep)
         {
-        case 3: // ST
-            // current score 20337 (1579/32768) [RMS: 88.57]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.000637792516f;
-            bestparams.topbit = 1.56725872f;
-            bestparams.distance1 = 0.00036806846f;
-            bestparams.distance2 = 1.51800942f;
-            break;
-        case 5: // PT
-            // current score 5190 (238/32768) [RMS: 83.54]
-            bestparams.threshold = 0.924780309f;
-            bestparams.pulsestrength = 1.96809769f;
-            bestparams.distance1 = 0.0888123438f;
-            bestparams.distance2 = 0.234606609f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
-        case 6: // PS
-            // current score 31015 (2181/32768) [RMS: 114.99]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.2328074f;
-            bestparams.pulsestrength = 3.9719491f;
-            bestparams.topbit = 0.73079139f;
-            bestparams.distance1 = 0.00156516861f;
-            bestparams.distance2 = 0.314677745f;
-            break;
-        case 7: // PST
-            // current score 9874 (201/32768) [RMS: 52.30]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.08558261f;
-            bestparams.pulsestrength = 1.52781796f;
-            bestparams.topbit = 0.857638359f;
-            bestparams.distance1 = 0.152927235f;
-            bestparams.distance2 = 1.02657032f;
-            break;
+            std::cout << "Sweeps are not supported in batch mode" << std::endl;
+            exit(EXIT_FAILURE);
         }
-    }
 
-    else if (strcmp(chip, "brokenr4ar3488") == 0)
-    {
-        switch (wave)
+        std::vector<const char*> chipList;
+        if (arg == argc)
         {
-        case 3: // ST
-            // current score 25216 (1567/32768) [RMS: 81.61]
-            bestparams.distFunc = Parameters::exponentialDistance;
-            bestparams.threshold = 0.0424066633f;
-            bestparams.topbit = 2.43467259f;
-            bestparams.distance1 = 0.000421410281f;
-            bestparams.distance2 = 2.81357718f;
-            break;
-        case 5: // PT
-            // current score 10938 (229/32768) [RMS: 88.64]
-            bestparams.threshold = 0.971203208f;
-            bestparams.pulsestrength = 1.92458713f;
-            bestparams.distance1 = 0.0430820882f;
-            bestparams.distance2 = 0.34782514f;
-            bestparams.distFunc = Parameters::linearDistance;
-            break;
-        case 6: // PS
-            // current score 22701 (1148/32768) [RMS: 113.05]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.99167538f;
-            bestparams.pulsestrength = 4.0302434f;
-            bestparams.topbit = 1.22495222f;
-            bestparams.distance1 = 1.01453114f;
-            bestparams.distance2 = 0.844035387f;
-            break;
-        case 7: // PST
-            // current score 7200 (132/32768) [RMS: 54.15]
-            bestparams.distFunc = Parameters::linearDistance;
-            bestparams.threshold = 1.1455301f;
-            bestparams.pulsestrength = 1.33257663f;
-            bestparams.topbit = 0.960132778f;
-            bestparams.distance1 = 0.381222129f;
-            bestparams.distance2 = 1.3617624f;
-            break;
+            for (const char* chip: chips)
+                chipList.push_back(chip);
+        }
+        else
+        {
+            for (; arg < argc; arg++)
+                chipList.push_back(argv[arg]);
         }
-    }
 
-    else {
-        std::cout << "Unrecognized chip" << std::endl;
-        exit(EXIT_FAILURE);
-    }
-#endif
-    if (bestparams.distance2 == 0.f)
-        bestparams.distance2 = bestparams.distance1;
-
-    // Calculate current score
-    score_t bestscore = bestparams.Score(wave, is8580, reference, true, 4096 * 255);
-    std::cout << "# initial score " << std::dec
-        << bestscore << std::endl
-        << bestparams.toString() << std::endl << std::endl;
-    if (bestscore.audible_error == 0)
-        exit(EXIT_SUCCESS);
+        options.dump = false;
 
-    /*
-     * Start the Monte Carlo loop: we randomly alter parameters
-     * and calculate the new score until we find the best fitting
-     * waveform compared to the sampled data.
-     */
-    Parameters p = bestparams;
-    for (;;)
-    {
-        // loop until at least one parameter has changed
-        bool changed = false;
-        while (!changed)
+        if (output)
         {
-            for (Param_t i = Param_t::THRESHOLD; i <= Param_t::DISTANCE2; i++)
+            std::ofstream ofs(output);
+            if (!ofs.is_open())
             {
-                // PULSESTRENGTH only affects pulse
-                if ((i==Param_t::PULSESTRENGTH) && ((wave & 0x04) != 0x04))
-                {
-                    continue;
-                }
-
-                // TOPBIT only affects saw
-                if ((i==Param_t::TOPBIT) && ((wave & 0x02) != 0x02))
-                {
-                    continue;
-                }
-
-                // change a parameter with 50% proability
-                if (GetRandomValue() > 1.)
-                {
-                    const float oldValue = bestparams.GetValue(i);
-
-                    //std::cout << newValue << " -> ";
-                    float newValue = static_cast<float>(GetRandomValue()*oldValue);
-                    //float newValue = oldValue + GetRandomValue();
-                    //std::cout << newValue << std::endl;
-
-                    // avoid negative values
-                    if (newValue <= 0.f)
-                    {
-                        newValue = EPSILON;
-                    }
-                    // try to avoid too small values
-                    else if (newValue < EPSILON)
-                        newValue += GetNewRandomValue();
-
-                    // check for parameters limits
-                    //if (((i == Param_t::THRESHOLD) || (i == Param_t::PULSESTRENGTH))
-                    //    && (newValue >= 1.f))
-                    //{
-                    //    newValue = 1.f - EPSILON;
-                    //}
-
-                    p.SetValue(i, newValue);
-                    changed = changed || oldValue != newValue;
-                }
+                std::cout << "Error opening file " << output << std::endl;
+                exit(EXIT_FAILURE);
             }
+            Batch(store, chipList, waves, options, warmStart, ofs, statsOut);
         }
-
-        // check new score
-        const score_t score = p.Score(wave, is8580, reference, false, bestscore.audible_error);
-        if (bestscore.isBetter(score))
-        {
-            // accept if improvement
-            std::cout << "# current score " << std::dec
-                << score << std::endl
-                << p.toString() << std::endl << std::endl;
-            if (score.audible_error == 0)
-                exit(EXIT_SUCCESS);
-            //p.reset();
-            bestparams = p;
-            bestscore = score;
-        }
-        else if (score.audible_error == bestscore.audible_error)
+        else
         {
-            // print the rate of wrong bits
-            std::cout << score.wrongBitsRate() << std::endl;
-
-            // no improvement but use new parameters as base to increase the "entropy"
-            bestparams = p;
+            Batch(store, chipList, waves, options, warmStart, std::cout, statsOut);
         }
+        exit(EXIT_SUCCESS);
     }
-}
 
-/**
- * Split a file into lines.
- */
-static std::vector<std::string> split(const std::string &s, char delim)
-{
-    std::vector<std::string> elems;
-    std::istringstream ss(s);
-    std::string item;
-    while (std::getline(ss, item, delim))
+    if (argc - arg != 2)
     {
-        elems.push_back(item);
+        Usage(argv[0]);
     }
-    return elems;
-}
 
-/**
- * Read sampled values for specific waveform and chip.
- */
-static ref_vector_t ReadChip(int wave, const char* chip)
-{
+    const int wave = atoi(argv[arg]);
+    assert(wave == 3 || wave == 5 || wave == 6 || wave == 7);
+
+    const char* chip = argv[arg + 1];
+
+    Corpus corpus;
+    OpenCorpus(corpus, { chip });
+
     std::cout << "Reading wave: " << wave << std::endl;
+    ref_vector_t reference = GetReference(corpus, wave, chip);
 
-    std::ostringstream fileName;
-    fileName << "sidwaves/" << chip << "/6581wf" << wave << "0.dat.prg";
-    std::ifstream ifs(fileName.str().c_str(), std::ifstream::in);
-    if (!ifs.is_open())
+#ifndef NDEBUG
+    if (!options.quiet)
     {
-        std::cout << "Error opening file " << fileName.str() << std::endl;
-        exit(EXIT_FAILURE);
+        for (ref_vector_t::iterator it = reference.begin(); it != reference.end(); ++it)
+            std::cout << static_cast<unsigned int>(*it) << '\n';
     }
-    ref_vector_t result;
-    char buffer[4098];
-    ifs.read(buffer, 4098);
-    for (int i=2; i<4098; i++)
+#endif
+
+    std::cout << "# seed " << options.seed << std::endl;
+
+    Parameters bestparams;
+    bool is8580;
+    if (!GetInitialParams(store, chip, wave, bestparams, is8580))
     {
-        result.push_back(static_cast<unsigned char>(buffer[i]));
+        std::string from;
+        if (warmStart && GetWarmStart(store, corpus, ChipClusters(corpus, wave), chip, wave, reference,
+                                      bestparams, is8580, from))
+            std::cout << "# no stored parameters, starting from the ones of " << from << std::endl;
+        else
+            std::cout << "# no stored parameters, starting from the defaults" << std::endl;
     }
-    return result;
-}
 
-int main(int argc, const char* argv[])
-{
-    if (argc != 3)
+    checkpoint_t checkpoint;
+    if (options.checkpoint)
     {
-        std::cout << "Usage " << argv[0] << " <waveform> <chip>" << std::endl;
-        exit(EXIT_FAILURE);
-    }
+        if (options.strategy != strategy_t::MONTE_CARLO)
+        {
+            std::cout << "Checkpoints are only supported by the Monte Carlo search" << std::endl;
+            exit(EXIT_FAILURE);
+        }
 
-    const int wave = atoi(argv[1]);
-    assert(wave == 3 || wave == 5 || wave == 6 || wave == 7);
+        // start a new fit only when there is no checkpoint, never replace one that can't be read
+        if (std::ifstream(options.checkpoint).is_open())
+        {
+            if (!checkpoint.Read(options.checkpoint))
+            {
+                std::cout << "Error reading checkpoint " << options.checkpoint
+                          << ", not a valid CWCK1 or CWCK2 file" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            if ((checkpoint.chip != chip) || (checkpoint.wave != wave))
+            {
+                std::cout << "Checkpoint " << options.checkpoint << " is for a different fit" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            is8580 = checkpoint.is8580;
+        }
+        else
+        {
+            checkpoint = checkpoint_t();
+            checkpoint.chip = chip;
+        }
 
-    const char* chip = argv[2];
+        // save a last checkpoint when asked to terminate
+        std::signal(SIGINT, Interrupt);
+        std::signal(SIGTERM, Interrupt);
+    }
+
+    // a resumed fit already has its starting point
+    if (sweep && checkpoint.evaluations)
+    {
+        std::cout << "# resuming " << options.checkpoint << ", the sweep is skipped" << std::endl;
+    }
+    else if (sweep)
+    {
+        Param_t x, y;
+        const std::vector<std::string> names = split(sweep, ',');
+        if ((names.size() != 2)
+            || !ParseParamName(names[0].c_str(), x) || !ParseParamName(names[1].c_str(), y)
+            || (x == y) || (sweepRange <= 1.))
+        {
+            Usage(argv[0]);
+        }
 
-    ref_vector_t reference = ReadChip(wave, chip);
+        const BatchScorer scorer(corpus);
+        GridSweep gridSweep(x, y, grid, levels, sweepRange);
+        score_t sweepscore;
+        bestparams = gridSweep.Run(scorer, corpus.Find(chip), wave, bestparams, sweepscore);
+        std::cout << "# sweep of " << names[0] << " and " << names[1] << ", "
+                  << gridSweep.Points().size() << " points, best score " << std::dec
+                  << sweepscore << std::endl
+                  << ToString(bestparams) << std::endl;
 
-#ifndef NDEBUG
-    for (ref_vector_t::iterator it = reference.begin(); it != reference.end(); ++it)
-        std::cout << (*it) << std::endl;
-#endif
+        if (landscape && !gridSweep.Write(landscape))
+        {
+            std::cout << "Error writing " << landscape << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    srand(time(0));
+    // the first interval of the statistics starts where the checkpoint was left
+    fit_stats_t resumed;
+    resumed.evaluations = checkpoint.evaluations;
+    resumed.seconds = checkpoint.seconds;
 
-    Optimize(reference, wave, chip);
+    const result_t result = Optimize(reference, wave, bestparams, is8580, options, std::cout,
+        [&](const Parameters &p, const score_t &score)
+        {
+            if (store.Update(chip, wave, is8580, p, GetStoredScore(p, score, wave, is8580, reference)))
+                store.Save(false);
+        },
+        GetReporter(statsOut, statsLock, chip, wave, resumed),
+        options.checkpoint ? &checkpoint : nullptr);
+    if (!result.ok)
+        exit(EXIT_FAILURE);
+    if (interrupted)
+        std::cout << "# interrupted, state saved to " << options.checkpoint << std::endl;
+    store.Update(chip, wave, is8580, result.params, GetStoredScore(result.params, result.score, wave, is8580, reference));
+    if (!store.Save())
+    {
+        std::cout << "Error saving " << paramsFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "# best score " << std::dec
+        << result.score << std::endl
+        << ToString(result.params) << std::endl
+        << "# " << result.evaluations << " evaluations in " << result.seconds << " seconds" << std::endl;
 }
@@ -0,0 +1,389 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+/**
+ * All the sampled combined waveforms packed in a single binary file.
+ *
+ * The file is made of a header, the chip names and then the samples:
+ *
+ *     char     magic[4]            "CWF2"
+ *     uint32_t count              number of chips, host byte order
+ *     char     name[count][32]    zero padded chip names
+ *     stamp_t  stamps[count][4]   size and modification time of the sampled files
+ *     uint8_t  samples[count][4][4096]
+ *
+ * with the waveforms in the order 3, 5, 6, 7.
+ * The file is created from the sidwaves directory the first time
+ * it is needed, when some chips are missing or when some of the sampled
+ * files have changed since, and then mapped in memory so the references
+ * can be used directly.
+ */
+class Corpus
+{
+public:
+    static constexpr const char* DEFAULT_FILE = "sidwaves.bin";
+
+    static constexpr unsigned int WAVES = 4;
+    static constexpr unsigned int SAMPLES = 4096;
+    static constexpr unsigned int NAME_SIZE = 32;
+
+private:
+    /// identifies the version of the sampled files used to build the corpus
+    struct stamp_t
+    {
+        uint64_t size;
+        int64_t mtime;
+    };
+
+    static constexpr const char MAGIC[4] = { 'C', 'W', 'F', '2' };
+    static constexpr unsigned int HEADER_SIZE = sizeof(MAGIC) + sizeof(uint32_t);
+    static constexpr unsigned int CHIP_HEADER_SIZE = NAME_SIZE + WAVES * sizeof(stamp_t);
+
+    const uint8_t* data;
+    size_t length;
+    unsigned int count;
+
+#ifdef _WIN32
+    std::vector<uint8_t> buffer;
+#endif
+
+private:
+    const char* Name(unsigned int chip) const
+    {
+        return reinterpret_cast<const char*>(data + HEADER_SIZE + chip * NAME_SIZE);
+    }
+
+    stamp_t Stamp(unsigned int chip, unsigned int wave) const
+    {
+        stamp_t stamp;
+        memcpy(&stamp, data + HEADER_SIZE + count * NAME_SIZE + (chip * WAVES + wave) * sizeof(stamp_t), sizeof(stamp));
+        return stamp;
+    }
+
+    void Close()
+    {
+#ifndef _WIN32
+        if (data)
+            munmap(const_cast<uint8_t*>(data), length);
+#else
+        buffer.clear();
+#endif
+        data = nullptr;
+        length = 0;
+        count = 0;
+    }
+
+    bool Map(const char* file)
+    {
+        Close();
+#ifndef _WIN32
+        const int fd = open(file, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(HEADER_SIZE))
+        {
+            close(fd);
+            return false;
+        }
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED)
+            return false;
+        data = static_cast<const uint8_t*>(addr);
+        length = st.st_size;
+#else
+        std::ifstream ifs(file, std::ifstream::binary);
+        if (!ifs.is_open())
+            return false;
+        buffer.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        if (buffer.size() < HEADER_SIZE)
+            return false;
+        data = buffer.data();
+        length = buffer.size();
+#endif
+        uint32_t n;
+        memcpy(&n, data + sizeof(MAGIC), sizeof(n));
+        if ((memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+            || (length != HEADER_SIZE + n * (CHIP_HEADER_SIZE + WAVES * SAMPLES)))
+        {
+            Close();
+            return false;
+        }
+        count = n;
+        return true;
+    }
+
+    static std::string FileName(int wave, const std::string &chip)
+    {
+        std::ostringstream fileName;
+        fileName << "sidwaves/" << chip << "/6581wf" << wave << "0.dat.prg";
+        return fileName.str();
+    }
+
+    /**
+     * Get the size and modification time of the sampled file.
+     *
+     * @return false if the file is missing
+     */
+    static bool GetStamp(int wave, const std::string &chip, stamp_t &stamp)
+    {
+        struct stat st;
+        if (stat(FileName(wave, chip).c_str(), &st) != 0)
+            return false;
+        stamp.size = st.st_size;
+        stamp.mtime = st.st_mtime;
+        return true;
+    }
+
+    /**
+     * Whether the sampled files of some chip have changed since the corpus was built.
+     * Missing files are ignored, so the corpus can be used without the sidwaves directory.
+     */
+    bool IsStale() const
+    {
+        for (unsigned int chip = 0; chip < count; chip++)
+        {
+            for (int wave : { 3, 5, 6, 7 })
+            {
+                stamp_t current;
+                if (!GetStamp(wave, Name(chip), current))
+                    continue;
+                const stamp_t stored = Stamp(chip, WaveIndex(wave));
+                if ((current.size != stored.size) || (current.mtime != stored.mtime))
+                {
+                    std::cout << "Samples of chip " << Name(chip) << " changed, rebuilding the corpus" << std::endl;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Read sampled values for specific waveform and chip.
+     */
+    static bool ReadChip(int wave, const std::string &chip, uint8_t samples[SAMPLES], stamp_t &stamp)
+    {
+        const std::string fileName = FileName(wave, chip);
+        if (!GetStamp(wave, chip, stamp))
+        {
+            std::cout << "Error opening file " << fileName << std::endl;
+            return false;
+        }
+        std::ifstream ifs(fileName.c_str(), std::ifstream::binary);
+        if (!ifs.is_open())
+        {
+            std::cout << "Error opening file " << fileName << std::endl;
+            return false;
+        }
+        // skip the load address
+        char buffer[SAMPLES + 2];
+        if (!ifs.read(buffer, sizeof(buffer)))
+        {
+            std::cout << "Error reading file " << fileName << std::endl;
+            return false;
+        }
+        memcpy(samples, buffer + 2, SAMPLES);
+        return true;
+    }
+
+    static bool Build(const char* file, const std::vector<std::string> &chips)
+    {
+        const uint32_t n = chips.size();
+        std::vector<uint8_t> out(HEADER_SIZE + n * (CHIP_HEADER_SIZE + WAVES * SAMPLES), 0);
+        memcpy(out.data(), MAGIC, sizeof(MAGIC));
+        memcpy(out.data() + sizeof(MAGIC), &n, sizeof(n));
+
+        uint8_t* stamps = out.data() + HEADER_SIZE + n * NAME_SIZE;
+        uint8_t* samples = out.data() + HEADER_SIZE + n * CHIP_HEADER_SIZE;
+        for (unsigned int chip = 0; chip < n; chip++)
+        {
+            if (chips[chip].size() >= NAME_SIZE)
+            {
+                std::cout << "Chip name too long " << chips[chip] << std::endl;
+                return false;
+            }
+            memcpy(out.data() + HEADER_SIZE + chip * NAME_SIZE, chips[chip].c_str(), chips[chip].size());
+
+            for (int wave : { 3, 5, 6, 7 })
+            {
+                stamp_t stamp;
+                if (!ReadChip(wave, chips[chip], samples, stamp))
+                    return false;
+                memcpy(stamps, &stamp, sizeof(stamp));
+                stamps += sizeof(stamp);
+                samples += SAMPLES;
+            }
+        }
+
+        // write to a temporary file so other processes never see a partial corpus
+        const std::string tmp = std::string(file) + ".tmp";
+        {
+            std::ofstream ofs(tmp.c_str(), std::ofstream::binary);
+            if (!ofs.is_open())
+            {
+                std::cout << "Error opening file " << tmp << std::endl;
+                return false;
+            }
+            ofs.write(reinterpret_cast<const char*>(out.data()), out.size());
+            if (!ofs)
+                return false;
+        }
+        return std::rename(tmp.c_str(), file) == 0;
+    }
+
+public:
+    Corpus() :
+        data(nullptr),
+        length(0),
+        count(0)
+    {}
+
+    ~Corpus() { Close(); }
+
+    Corpus(const Corpus&) = delete;
+    Corpus& operator=(const Corpus&) = delete;
+
+    /**
+     * Open the corpus, building it first if it's missing some of the chips
+     * or if some of the sampled files have changed.
+     *
+     * @param chips the chips that must be present in the corpus
+     * @param file the corpus file name
+     * @return false on error, which is reported on stdout
+     */
+    bool Open(const std::vector<std::string> &chips, const char* file = DEFAULT_FILE)
+    {
+        std::vector<std::string> names;
+        if (Map(file))
+        {
+            for (unsigned int chip = 0; chip < count; chip++)
+                names.push_back(Name(chip));
+        }
+
+        bool complete = true;
+        for (const std::string &chip: chips)
+        {
+            if (Find(chip.c_str()) < 0)
+            {
+                names.push_back(chip);
+                complete = false;
+            }
+        }
+        if (complete && data && !IsStale())
+            return true;
+
+        Close();
+        if (!Build(file, names) || !Map(file))
+        {
+            std::cout << "Error creating corpus " << file << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Get the number of chips.
+     */
+    unsigned int size() const { return count; }
+
+    /**
+     * Get the index of the chip, -1 if not found.
+     */
+    int Find(const char* chip) const
+    {
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (strncmp(Name(i), chip, NAME_SIZE) == 0)
+                return i;
+        }
+        return -1;
+    }
+
+    /**
+     * Get the index of the waveform in the corpus, -1 if not sampled.
+     */
+    static int WaveIndex(int wave)
+    {
+        switch (wave)
+        {
+        case 3: return 0;
+        case 5: return 1;
+        case 6: return 2;
+        case 7: return 3;
+        default: return -1;
+        }
+    }
+
+    /**
+     * Get the 4096 sampled values for specific waveform and chip.
+     */
+    const uint8_t* Get(unsigned int chip, int wave) const
+    {
+        return data + HEADER_SIZE + count * CHIP_HEADER_SIZE + (chip * WAVES + WaveIndex(wave)) * SAMPLES;
+    }
+
+    /**
+     * Get the name of the chip.
+     */
+    std::string GetName(unsigned int chip) const
+    {
+        return std::string(Name(chip), strnlen(Name(chip), NAME_SIZE));
+    }
+
+    /**
+     * Get the distance between the samples of two chips for a waveform,
+     * the same audible error used to score the parameters.
+     */
+    unsigned int Distance(unsigned int chip1, unsigned int chip2, int wave) const
+    {
+        const uint8_t* a = Get(chip1, wave);
+        const uint8_t* b = Get(chip2, wave);
+        unsigned int sum = 0;
+        for (unsigned int j = 0; j < SAMPLES; j++)
+            sum += a[j] ^ b[j];
+        return sum;
+    }
+};
+
+#endif
@@ -0,0 +1,285 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef FIXED_H
+#define FIXED_H
+
+#include "mixer.h"
+
+#include <cmath>
+#include <cstdint>
+
+/**
+ * Fixed point version of the bit mixing model.
+ *
+ * The predicted bit is set when the input bit is high and
+ *
+ *     1 - (pulldown - pulse) / n > threshold
+ *
+ * that is
+ *
+ *     pulldown / n < 1 - threshold + pulse / n
+ *
+ * so dividing the weights by n beforehand they become fractions of a unit
+ * and the threshold and pulse fold in a single limit per output bit.
+ * The weights are stored with 24 fractional bits and accumulated in
+ * integers, which makes the results independent of the order of the sums
+ * and removes the divisions, at the price of a small difference from
+ * the floating point model near the threshold.
+ */
+class FixedMixer
+{
+public:
+    static constexpr unsigned int BATCH = Mixer::BATCH;
+
+    static constexpr int FRACTION_BITS = 24;
+
+    /// bound of the weights, so that the sum of all of them can't overflow
+    static constexpr int32_t MAX_WEIGHT = 1 << 27;
+
+private:
+    typedef void (*kernel_t)(const FixedMixer&, const unsigned int*, unsigned int*);
+
+    /// weight of input bit cb on output bit 4+sb, zero for the bit itself
+    int32_t weights[11][8];
+
+    /// contribution of the top bit when low and high
+    int32_t topweights[2][8];
+
+    /// the output bit is set if the input is high and the sum is below the limit
+    int32_t limits[8];
+
+    /// whether the top bit is still high after being scaled by topbit
+    bool topbitHigh;
+
+private:
+    static int32_t ToFixed(double v, int32_t max)
+    {
+        const double scaled = std::round(std::ldexp(v, FRACTION_BITS));
+        if (scaled < -max)
+            return -max;
+        if (scaled > max)
+            return max;
+        return static_cast<int32_t>(scaled);
+    }
+
+    unsigned int Score8(unsigned int osc) const
+    {
+        int32_t sum[8];
+        for (int sb = 0; sb < 8; sb++)
+            sum[sb] = topweights[(osc >> 11) & 1][sb];
+
+        for (int cb = 0; cb < 11; cb++)
+        {
+            if (osc & (1 << cb))
+                continue;
+            for (int sb = 0; sb < 8; sb++)
+                sum[sb] += weights[cb][sb];
+        }
+
+        const unsigned int high = (osc >> 4) & (topbitHigh ? 0xff : 0x7f);
+        unsigned int result = 0;
+        for (int sb = 0; sb < 8; sb++)
+        {
+            if (sum[sb] < limits[sb])
+                result |= 1 << sb;
+        }
+        return result & high;
+    }
+
+    static void Score8Scalar(const FixedMixer &mixer, const unsigned int osc[], unsigned int simval[])
+    {
+        for (unsigned int i = 0; i < BATCH; i++)
+            simval[i] = mixer.Score8(osc[i]);
+    }
+
+#ifdef MIXER_X86_SIMD
+    __attribute__((target("avx2")))
+    static void Score8Avx2(const FixedMixer &mixer, const unsigned int osc[], unsigned int simval[])
+    {
+        for (unsigned int i = 0; i < BATCH; i += 8)
+        {
+            const __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(osc + i));
+            const __m256i top = _mm256_cmpeq_epi32(
+                _mm256_and_si256(o, _mm256_set1_epi32(0x800)), _mm256_set1_epi32(0x800));
+
+            __m256i sum[8];
+            for (int sb = 0; sb < 8; sb++)
+            {
+                sum[sb] = _mm256_blendv_epi8(
+                    _mm256_set1_epi32(mixer.topweights[0][sb]),
+                    _mm256_set1_epi32(mixer.topweights[1][sb]),
+                    top);
+            }
+
+            for (int cb = 0; cb < 11; cb++)
+            {
+                const __m256i bit = _mm256_set1_epi32(1 << cb);
+                const __m256i high = _mm256_cmpeq_epi32(_mm256_and_si256(o, bit), bit);
+                for (int sb = 0; sb < 8; sb++)
+                {
+                    sum[sb] = _mm256_add_epi32(sum[sb],
+                        _mm256_andnot_si256(high, _mm256_set1_epi32(mixer.weights[cb][sb])));
+                }
+            }
+
+            __m256i result = _mm256_setzero_si256();
+            for (int sb = 0; sb < 8; sb++)
+            {
+                const __m256i below = _mm256_cmpgt_epi32(_mm256_set1_epi32(mixer.limits[sb]), sum[sb]);
+                result = _mm256_or_si256(result, _mm256_and_si256(below, _mm256_set1_epi32(1 << sb)));
+            }
+
+            const __m256i high = _mm256_and_si256(_mm256_srli_epi32(o, 4),
+                _mm256_set1_epi32(mixer.topbitHigh ? 0xff : 0x7f));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(simval + i), _mm256_and_si256(result, high));
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    static void Score8Avx512(const FixedMixer &mixer, const unsigned int osc[], unsigned int simval[])
+    {
+        static_assert(BATCH == 16, "AVX-512 kernel processes 16 values at a time");
+
+        const __m512i o = _mm512_loadu_si512(osc);
+        const __mmask16 top = _mm512_test_epi32_mask(o, _mm512_set1_epi32(0x800));
+
+        __m512i sum[8];
+        for (int sb = 0; sb < 8; sb++)
+        {
+            sum[sb] = _mm512_mask_blend_epi32(top,
+                _mm512_set1_epi32(mixer.topweights[0][sb]),
+                _mm512_set1_epi32(mixer.topweights[1][sb]));
+        }
+
+        for (int cb = 0; cb < 11; cb++)
+        {
+            const __mmask16 low = _mm512_testn_epi32_mask(o, _mm512_set1_epi32(1 << cb));
+            for (int sb = 0; sb < 8; sb++)
+                sum[sb] = _mm512_mask_add_epi32(sum[sb], low, sum[sb], _mm512_set1_epi32(mixer.weights[cb][sb]));
+        }
+
+        __m512i result = _mm512_setzero_si512();
+        for (int sb = 0; sb < 8; sb++)
+        {
+            const __mmask16 below = _mm512_cmplt_epi32_mask(sum[sb], _mm512_set1_epi32(mixer.limits[sb]));
+            result = _mm512_mask_or_epi32(result, below, result, _mm512_set1_epi32(1 << sb));
+        }
+
+        // the fully masked shift, as the plain one gives a spurious -Wuninitialized on GCC 12
+        const __m512i high = _mm512_and_si512(_mm512_maskz_srli_epi32(0xffff, o, 4),
+            _mm512_set1_epi32(mixer.topbitHigh ? 0xff : 0x7f));
+        _mm512_storeu_si512(simval, _mm512_and_si512(result, high));
+    }
+#endif
+
+    static kernel_t GetKernel(Mixer::simd_t simd)
+    {
+        switch (simd)
+        {
+#ifdef MIXER_X86_SIMD
+        case Mixer::simd_t::AVX512: return Score8Avx512;
+        case Mixer::simd_t::AVX2: return Score8Avx2;
+#endif
+        default: return Score8Scalar;
+        }
+    }
+
+    static kernel_t& kernel()
+    {
+        static kernel_t k = GetKernel(Mixer::BestSimd());
+        return k;
+    }
+
+public:
+    /**
+     * Select the instruction set used by the batch scoring,
+     * by default the widest one supported is used.
+     * Unsupported sets fall back to scalar code.
+     */
+    static void UseSimd(Mixer::simd_t simd)
+    {
+        kernel() = (simd <= Mixer::BestSimd()) ? GetKernel(simd) : Score8Scalar;
+    }
+
+    /**
+     * @param wa the weight as a function of distance, wa[12] being the bit itself
+     * @param pulsestrength the pulse pulldown strength
+     * @param topbit the top bit multiplier
+     * @param hasPulse whether pulse is selected
+     * @param threshold the threshold of the output bits
+     */
+    FixedMixer(const float wa[], float pulsestrength, float topbit, bool hasPulse, float threshold) :
+        topbitHigh(topbit != 0.f)
+    {
+        const double pulse = hasPulse ? pulsestrength : 0.;
+
+        for (int sb = 0; sb < 8; sb++)
+        {
+            const int out = 4 + sb;
+
+            double n = 0.;
+            bool finite = true;
+            for (int cb = 0; cb < 12; cb++)
+            {
+                if (cb == out)
+                    continue;
+                const float weight = wa[out - cb + 12];
+                n += weight;
+                finite = finite && std::isfinite(weight);
+            }
+
+            if (!finite || (n == 0.) || !std::isfinite(n))
+            {
+                // degenerate weights, the output bit is always clear. The two models deliberately
+                // disagree here: the floating point one divides by a zero or non finite sum, giving
+                // NaNs which never exceed the threshold but also infinities, as with n == 0 and
+                // a pulse pulldown, which do and set the bit
+                for (int cb = 0; cb < 11; cb++)
+                    weights[cb][sb] = 0;
+                topweights[0][sb] = topweights[1][sb] = 0;
+                limits[sb] = INT32_MIN;
+                continue;
+            }
+
+            for (int cb = 0; cb < 11; cb++)
+                weights[cb][sb] = (cb == out) ? 0 : ToFixed(wa[out - cb + 12] / n, MAX_WEIGHT);
+
+            const double top = (out == 11) ? 0. : wa[out - 11 + 12] / n;
+            topweights[0][sb] = ToFixed(top, MAX_WEIGHT);
+            topweights[1][sb] = ToFixed((1. - topbit) * top, MAX_WEIGHT);
+
+            limits[sb] = ToFixed((1. - threshold) + pulse / n, INT32_MAX);
+        }
+    }
+
+    /**
+     * Get the upper 8 bits of the predicted value
+     * for BATCH oscillator values at once.
+     *
+     * @param threshold unused, it's fixed at construction
+     */
+    void Score8(const unsigned int osc[BATCH], float, unsigned int simval[BATCH]) const
+    {
+        kernel()(*this, osc, simval);
+    }
+};
+
+#endif
@@ -0,0 +1,659 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#  define MIXER_X86_SIMD
+#  include <immintrin.h>
+#endif
+
+/**
+ * Bit mixing model with the weights precomputed for a given set of parameters.
+ *
+ * Each output bit sb is pulled down by the grounded input bits cb
+ * with a strength depending on their distance:
+ *
+ *     pulldown[sb] = (sum((1 - bit[cb]) * w[sb][cb]) - pulsestrength) / n[sb]
+ *
+ * As the input bits are either 0 or 1 (with the exception of the top bit
+ * which may be scaled by topbit) the sum is just the accumulation of the
+ * weight rows of the grounded bits, so the 12x12 product reduces to walking
+ * the clear bits of the oscillator value.
+ * The rows are accumulated in the same order as the plain double loop
+ * so the results are bit exact.
+ */
+class Mixer
+{
+public:
+    /// Number of oscillator values processed at once by Score8
+    static constexpr unsigned int BATCH = 16;
+
+    enum class simd_t
+    {
+        SCALAR,
+        AVX2,
+        AVX512
+    };
+
+    /**
+     * Plain copy of the weights of the upper 8 bits, for the code
+     * that can't use the class, such as the accelerator kernels.
+     */
+    struct weights_t
+    {
+        float rows[11][2][8];
+        float topweights[8];
+        float topfactor[2];
+        float norm[8];
+        float pulse;
+        bool topbitHigh;
+        bool finite;
+    };
+
+private:
+    typedef void (*kernel_t)(const Mixer&, const unsigned int*, float, unsigned int*);
+
+    typedef void (*finish_t)(const Mixer&, const unsigned int*, const float*, unsigned int, float, unsigned int*);
+
+    typedef void (*keep_t)(const Mixer&, const unsigned int*, float, unsigned int*, float*, unsigned int);
+
+    /**
+     * rows[cb][level][sb] is the contribution of input bit cb at the given level
+     * to the pulldown of output bit sb, that is (1 - level) * weight.
+     * The contribution of an input bit to itself is zero.
+     */
+    float rows[11][2][12];
+
+    /// weights of the top bit, which is scaled by topbit and thus not just 0 or 1
+    float topweights[12];
+
+    /// (1 - level) factor of the top bit
+    float topfactor[2];
+
+    /// per bit normalizer, sum of the weights of all the other bits
+    float norm[12];
+
+    /// pulse pulldown, zero if pulse is not selected
+    float pulse;
+
+    /// whether the top bit is still high after being scaled by topbit
+    bool topbitHigh;
+
+    /**
+     * Whether all the weights are finite, in which case
+     * the contribution of the high bits is zero and can be skipped.
+     * Otherwise they must be accumulated to propagate the NaNs.
+     */
+    bool finite;
+
+private:
+    /**
+     * Multiply and add, fused when the target supports it.
+     * The scalar and vector paths must round the same way.
+     */
+    static float madd(float a, float b, float c)
+    {
+#ifdef __FMA__
+        return std::fma(a, b, c);
+#else
+        return a * b + c;
+#endif
+    }
+
+    static void Score8Scalar(const Mixer &mixer, const unsigned int osc[], float threshold, unsigned int simval[])
+    {
+        for (unsigned int i = 0; i < BATCH; i++)
+            simval[i] = mixer.Score8(osc[i], threshold);
+    }
+
+    static void Finish8Scalar(const Mixer &mixer, const unsigned int osc[], const float avg[], unsigned int stride,
+                              float threshold, unsigned int simval[])
+    {
+        for (unsigned int i = 0; i < BATCH; i++)
+        {
+            float a[12];
+            for (int sb = 0; sb < 8; sb++)
+                a[4+sb] = avg[sb * stride + i];
+            simval[i] = mixer.Finish8(osc[i], a, threshold);
+        }
+    }
+
+    static void Keep8Scalar(const Mixer &mixer, const unsigned int osc[], float threshold, unsigned int simval[],
+                            float avg[], unsigned int stride)
+    {
+        for (unsigned int i = 0; i < BATCH; i++)
+        {
+            float a[12];
+            mixer.Accumulate<4>(osc[i], a);
+            for (int sb = 0; sb < 8; sb++)
+                avg[sb * stride + i] = a[4+sb];
+            simval[i] = mixer.Finish8(osc[i], a, threshold);
+        }
+    }
+
+#ifdef MIXER_X86_SIMD
+    /*
+     * The vector kernels work on the structure of arrays layout,
+     * each lane holding a different oscillator value,
+     * and must give the very same results of the scalar code.
+     */
+
+    /**
+     * Get the levels of the input bits and accumulate the rows of the upper 8 bits.
+     */
+    __attribute__((target("avx2")))
+    static void Accumulate8Avx2(const Mixer &mixer, const unsigned int osc[], __m256 high[12], __m256 avg[8])
+    {
+        const __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(osc));
+
+        for (int cb = 0; cb < 12; cb++)
+        {
+            const __m256i bit = _mm256_set1_epi32(1 << cb);
+            high[cb] = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(o, bit), bit));
+        }
+
+        for (int sb = 0; sb < 8; sb++)
+            avg[sb] = _mm256_setzero_ps();
+
+        for (int cb = 0; cb < 11; cb++)
+        {
+            for (int sb = 0; sb < 8; sb++)
+            {
+                const __m256 row = _mm256_blendv_ps(
+                    _mm256_set1_ps(mixer.rows[cb][0][4+sb]),
+                    _mm256_set1_ps(mixer.rows[cb][1][4+sb]),
+                    high[cb]);
+                avg[sb] = _mm256_add_ps(avg[sb], row);
+            }
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static void Score8Avx2(const Mixer &mixer, const unsigned int osc[], float threshold, unsigned int simval[])
+    {
+        for (unsigned int i = 0; i < BATCH; i += 8)
+        {
+            __m256 high[12];
+            __m256 avg[8];
+            Accumulate8Avx2(mixer, osc + i, high, avg);
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(simval + i), Finish8Avx2(mixer, high, avg, threshold));
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static void Keep8Avx2(const Mixer &mixer, const unsigned int osc[], float threshold, unsigned int simval[],
+                          float avg[], unsigned int stride)
+    {
+        for (unsigned int i = 0; i < BATCH; i += 8)
+        {
+            __m256 high[12];
+            __m256 a[8];
+            Accumulate8Avx2(mixer, osc + i, high, a);
+
+            for (int sb = 0; sb < 8; sb++)
+                _mm256_storeu_ps(avg + sb * stride + i, a[sb]);
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(simval + i), Finish8Avx2(mixer, high, a, threshold));
+        }
+    }
+
+    /**
+     * Add the top bit to the accumulated rows and get the output bits.
+     */
+    __attribute__((target("avx2")))
+    static __m256i Finish8Avx2(const Mixer &mixer, __m256 high[12], __m256 avg[8], float threshold)
+    {
+        const __m256 factor = _mm256_blendv_ps(
+            _mm256_set1_ps(mixer.topfactor[0]),
+            _mm256_set1_ps(mixer.topfactor[1]),
+            high[11]);
+        if (!mixer.topbitHigh)
+            high[11] = _mm256_setzero_ps();
+
+        const __m256 one = _mm256_set1_ps(1.f);
+        const __m256 pulse = _mm256_set1_ps(mixer.pulse);
+        const __m256 thr = _mm256_set1_ps(threshold);
+
+        __m256i result = _mm256_setzero_si256();
+        for (int sb = 0; sb < 8; sb++)
+        {
+            const __m256 w = _mm256_set1_ps(mixer.topweights[4+sb]);
+#ifdef __FMA__
+            avg[sb] = _mm256_fmadd_ps(factor, w, avg[sb]);
+#else
+            avg[sb] = _mm256_add_ps(_mm256_mul_ps(factor, w), avg[sb]);
+#endif
+            __m256 val = _mm256_sub_ps(one,
+                _mm256_div_ps(_mm256_sub_ps(avg[sb], pulse), _mm256_set1_ps(mixer.norm[4+sb])));
+            val = _mm256_and_ps(val, high[4+sb]);
+            const __m256 gt = _mm256_cmp_ps(val, thr, _CMP_GT_OQ);
+            result = _mm256_or_si256(result,
+                _mm256_and_si256(_mm256_castps_si256(gt), _mm256_set1_epi32(1 << sb)));
+        }
+        return result;
+    }
+
+    __attribute__((target("avx2")))
+    static void Finish8Avx2(const Mixer &mixer, const unsigned int osc[], const float avg[], unsigned int stride,
+                            float threshold, unsigned int simval[])
+    {
+        for (unsigned int i = 0; i < BATCH; i += 8)
+        {
+            const __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(osc + i));
+
+            __m256 high[12];
+            for (int cb = 4; cb < 12; cb++)
+            {
+                const __m256i bit = _mm256_set1_epi32(1 << cb);
+                high[cb] = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(o, bit), bit));
+            }
+
+            __m256 a[8];
+            for (int sb = 0; sb < 8; sb++)
+                a[sb] = _mm256_loadu_ps(avg + sb * stride + i);
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(simval + i), Finish8Avx2(mixer, high, a, threshold));
+        }
+    }
+
+    /**
+     * Get the levels of the input bits and accumulate the rows of the upper 8 bits.
+     */
+    __attribute__((target("avx512f")))
+    static void Accumulate8Avx512(const Mixer &mixer, const unsigned int osc[], __mmask16 high[12], __m512 avg[8])
+    {
+        static_assert(BATCH == 16, "AVX-512 kernel processes 16 values at a time");
+
+        const __m512i o = _mm512_loadu_si512(osc);
+
+        for (int cb = 0; cb < 12; cb++)
+            high[cb] = _mm512_test_epi32_mask(o, _mm512_set1_epi32(1 << cb));
+
+        for (int sb = 0; sb < 8; sb++)
+            avg[sb] = _mm512_setzero_ps();
+
+        for (int cb = 0; cb < 11; cb++)
+        {
+            for (int sb = 0; sb < 8; sb++)
+            {
+                if (mixer.finite)
+                {
+                    // high bits add nothing
+                    avg[sb] = _mm512_mask_add_ps(avg[sb], static_cast<__mmask16>(~high[cb]),
+                        avg[sb], _mm512_set1_ps(mixer.rows[cb][0][4+sb]));
+                }
+                else
+                {
+                    const __m512 row = _mm512_mask_blend_ps(high[cb],
+                        _mm512_set1_ps(mixer.rows[cb][0][4+sb]),
+                        _mm512_set1_ps(mixer.rows[cb][1][4+sb]));
+                    avg[sb] = _mm512_add_ps(avg[sb], row);
+                }
+            }
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    static void Score8Avx512(const Mixer &mixer, const unsigned int osc[], float threshold, unsigned int simval[])
+    {
+        __mmask16 high[12];
+        __m512 avg[8];
+        Accumulate8Avx512(mixer, osc, high, avg);
+
+        _mm512_storeu_si512(simval, Finish8Avx512(mixer, high, avg, threshold));
+    }
+
+    __attribute__((target("avx512f")))
+    static void Keep8Avx512(const Mixer &mixer, const unsigned int osc[], float threshold, unsigned int simval[],
+                            float avg[], unsigned int stride)
+    {
+        __mmask16 high[12];
+        __m512 a[8];
+        Accumulate8Avx512(mixer, osc, high, a);
+
+        for (int sb = 0; sb < 8; sb++)
+            _mm512_storeu_ps(avg + sb * stride, a[sb]);
+
+        _mm512_storeu_si512(simval, Finish8Avx512(mixer, high, a, threshold));
+    }
+
+    /**
+     * Add the top bit to the accumulated rows and get the output bits.
+     */
+    __attribute__((target("avx512f")))
+    static __m512i Finish8Avx512(const Mixer &mixer, __mmask16 high[12], __m512 avg[8], float threshold)
+    {
+        const __m512 factor = _mm512_mask_blend_ps(high[11],
+            _mm512_set1_ps(mixer.topfactor[0]),
+            _mm512_set1_ps(mixer.topfactor[1]));
+        if (!mixer.topbitHigh)
+            high[11] = 0;
+
+        const __m512 one = _mm512_set1_ps(1.f);
+        const __m512 pulse = _mm512_set1_ps(mixer.pulse);
+        const __m512 thr = _mm512_set1_ps(threshold);
+
+        __m512i result = _mm512_setzero_si512();
+        for (int sb = 0; sb < 8; sb++)
+        {
+            const __m512 w = _mm512_set1_ps(mixer.topweights[4+sb]);
+#ifdef __FMA__
+            avg[sb] = _mm512_fmadd_ps(factor, w, avg[sb]);
+#else
+            avg[sb] = _mm512_add_ps(_mm512_mul_ps(factor, w), avg[sb]);
+#endif
+            __m512 val = _mm512_sub_ps(one,
+                _mm512_div_ps(_mm512_sub_ps(avg[sb], pulse), _mm512_set1_ps(mixer.norm[4+sb])));
+            val = _mm512_maskz_mov_ps(high[4+sb], val);
+            const __mmask16 gt = _mm512_cmp_ps_mask(val, thr, _CMP_GT_OQ);
+            result = _mm512_mask_or_epi32(result, gt, result, _mm512_set1_epi32(1 << sb));
+        }
+        return result;
+    }
+
+    __attribute__((target("avx512f")))
+    static void Finish8Avx512(const Mixer &mixer, const unsigned int osc[], const float avg[], unsigned int stride,
+                              float threshold, unsigned int simval[])
+    {
+        const __m512i o = _mm512_loadu_si512(osc);
+
+        __mmask16 high[12];
+        for (int cb = 4; cb < 12; cb++)
+            high[cb] = _mm512_test_epi32_mask(o, _mm512_set1_epi32(1 << cb));
+
+        __m512 a[8];
+        for (int sb = 0; sb < 8; sb++)
+            a[sb] = _mm512_loadu_ps(avg + sb * stride);
+
+        _mm512_storeu_si512(simval, Finish8Avx512(mixer, high, a, threshold));
+    }
+#endif
+
+    static kernel_t GetKernel(simd_t simd)
+    {
+        switch (simd)
+        {
+#ifdef MIXER_X86_SIMD
+        case simd_t::AVX512: return Score8Avx512;
+        case simd_t::AVX2: return Score8Avx2;
+#endif
+        default: return Score8Scalar;
+        }
+    }
+
+    static kernel_t& kernel()
+    {
+        static kernel_t k = GetKernel(BestSimd());
+        return k;
+    }
+
+    static finish_t GetFinisher(simd_t simd)
+    {
+        switch (simd)
+        {
+#ifdef MIXER_X86_SIMD
+        case simd_t::AVX512: return Finish8Avx512;
+        case simd_t::AVX2: return Finish8Avx2;
+#endif
+        default: return Finish8Scalar;
+        }
+    }
+
+    static finish_t& finisher()
+    {
+        static finish_t f = GetFinisher(BestSimd());
+        return f;
+    }
+
+    static keep_t GetKeeper(simd_t simd)
+    {
+        switch (simd)
+        {
+#ifdef MIXER_X86_SIMD
+        case simd_t::AVX512: return Keep8Avx512;
+        case simd_t::AVX2: return Keep8Avx2;
+#endif
+        default: return Keep8Scalar;
+        }
+    }
+
+    static keep_t& keeper()
+    {
+        static keep_t k = GetKeeper(BestSimd());
+        return k;
+    }
+
+public:
+    /**
+     * Get the widest instruction set supported by the CPU.
+     */
+    static simd_t BestSimd()
+    {
+#ifdef MIXER_X86_SIMD
+        if (__builtin_cpu_supports("avx512f"))
+            return simd_t::AVX512;
+        if (__builtin_cpu_supports("avx2"))
+            return simd_t::AVX2;
+#endif
+        return simd_t::SCALAR;
+    }
+
+    /**
+     * Select the instruction set used by the batch scoring,
+     * by default the widest one supported is used.
+     * Unsupported sets fall back to scalar code.
+     */
+    static void UseSimd(simd_t simd)
+    {
+        kernel() = (simd <= BestSimd()) ? GetKernel(simd) : Score8Scalar;
+        finisher() = (simd <= BestSimd()) ? GetFinisher(simd) : Finish8Scalar;
+        keeper() = (simd <= BestSimd()) ? GetKeeper(simd) : Keep8Scalar;
+    }
+
+public:
+    /**
+     * @param wa the weight as a function of distance, wa[12] being the bit itself
+     * @param pulsestrength the pulse pulldown strength
+     * @param topbit the top bit multiplier
+     * @param hasPulse whether pulse is selected
+     */
+    Mixer(const float wa[], float pulsestrength, float topbit, bool hasPulse) :
+        pulse(hasPulse ? pulsestrength : 0.f),
+        topbitHigh(topbit != 0.f),
+        finite(true)
+    {
+        topfactor[0] = 1.f;
+        topfactor[1] = 1.f - topbit;
+
+        for (int sb = 0; sb < 12; sb++)
+        {
+            float n = 0.f;
+            for (int cb = 0; cb < 12; cb++)
+            {
+                const float weight = (cb == sb) ? 0.f : wa[sb - cb + 12];
+                if (cb == 11)
+                {
+                    topweights[sb] = weight;
+                }
+                else
+                {
+                    rows[cb][0][sb] = weight;
+                    rows[cb][1][sb] = 0.f * weight;
+                }
+                if (cb == sb)
+                    continue;
+                n += weight;
+                if (!std::isfinite(weight))
+                    finite = false;
+            }
+            norm[sb] = n;
+        }
+    }
+
+    /**
+     * Calculate the analog value of the bits from first to 11.
+     *
+     * @param osc the 12 bit input value
+     * @param bitarray the output values
+     */
+    template<int first = 0>
+    void Simulate(unsigned int osc, float bitarray[12]) const
+    {
+        float avg[12];
+        Accumulate<first>(osc, avg);
+        Finish<first>(osc, avg, bitarray);
+    }
+
+    /**
+     * Accumulate the weight rows of the grounded input bits from first to 10
+     * into the pulldown of the bits from first to 11, the part of the mix
+     * which depends only on the distances and not on the other parameters.
+     */
+    template<int first = 0>
+    void Accumulate(unsigned int osc, float avg[12]) const
+    {
+        for (int sb = first; sb < 12; sb++)
+            avg[sb] = 0.f;
+
+        for (int cb = 0; cb < 11; cb++)
+        {
+            const unsigned int level = (osc >> cb) & 1;
+            if (level && finite)
+                continue;
+            const float* const row = rows[cb][level];
+            for (int sb = first; sb < 12; sb++)
+                avg[sb] += row[sb];
+        }
+    }
+
+    /**
+     * Add the top bit to the accumulated rows and normalize them.
+     */
+    template<int first = 0>
+    void Finish(unsigned int osc, const float avg[12], float bitarray[12]) const
+    {
+        const float factor = topfactor[(osc >> 11) & 1];
+        for (int sb = first; sb < 12; sb++)
+        {
+            const float a = madd(factor, topweights[sb], avg[sb]);
+            const bool high = (sb == 11) ? (osc & 0x800) && topbitHigh : (osc & (1 << sb));
+            bitarray[sb] = high ? 1.f - (a - pulse) / norm[sb] : 0.f;
+        }
+    }
+
+    /**
+     * Get the weights of the upper 8 bits.
+     */
+    void GetWeights(weights_t &w) const
+    {
+        for (int sb = 0; sb < 8; sb++)
+        {
+            for (int cb = 0; cb < 11; cb++)
+            {
+                w.rows[cb][0][sb] = rows[cb][0][4+sb];
+                w.rows[cb][1][sb] = rows[cb][1][4+sb];
+            }
+            w.topweights[sb] = topweights[4+sb];
+            w.norm[sb] = norm[4+sb];
+        }
+        w.topfactor[0] = topfactor[0];
+        w.topfactor[1] = topfactor[1];
+        w.pulse = pulse;
+        w.topbitHigh = topbitHigh;
+        w.finite = finite;
+    }
+
+    /**
+     * Get the contribution of the input bit cb at the given level to the pulldown of the output bit sb.
+     */
+    float GetRow(int cb, unsigned int level, int sb) const
+    {
+        return rows[cb][level][sb];
+    }
+
+    /**
+     * Get the upper 8 bits of the predicted value.
+     */
+    unsigned int Score8(unsigned int osc, float threshold) const
+    {
+        float avg[12];
+        Accumulate<4>(osc, avg);
+        return Finish8(osc, avg, threshold);
+    }
+
+    /**
+     * Get the upper 8 bits of the predicted value from the accumulated rows.
+     */
+    unsigned int Finish8(unsigned int osc, const float avg[12], float threshold) const
+    {
+        float bitarray[12];
+        Finish<4>(osc, avg, bitarray);
+
+        unsigned int result = 0;
+        for (int cb = 0; cb < 8; cb++)
+        {
+            if (bitarray[4+cb] > threshold)
+                result |= 1 << cb;
+        }
+        return result;
+    }
+
+    /**
+     * Get the upper 8 bits of the predicted value
+     * for BATCH oscillator values at once.
+     */
+    void Score8(const unsigned int osc[BATCH], float threshold, unsigned int simval[BATCH]) const
+    {
+        kernel()(*this, osc, threshold, simval);
+    }
+
+    /**
+     * Get the upper 8 bits of the predicted value for BATCH oscillator
+     * values at once from their accumulated rows, skipping the mix.
+     * The rows must come from a mixer with the same distances.
+     *
+     * @param avg the accumulated rows of the output bit 4+sb of the value i are at avg[sb * stride + i]
+     */
+    void Score8(const unsigned int osc[BATCH], const float avg[], unsigned int stride, float threshold,
+                unsigned int simval[BATCH]) const
+    {
+        finisher()(*this, osc, avg, stride, threshold, simval);
+    }
+
+    /**
+     * Get the upper 8 bits of the predicted value for BATCH oscillator
+     * values at once, keeping also their accumulated rows, the part
+     * of the mix which depends only on the distances.
+     *
+     * @param avg the accumulated rows of the output bit 4+sb of the value i go to avg[sb * stride + i]
+     */
+    void Score8Keep(const unsigned int osc[BATCH], float threshold, unsigned int simval[BATCH],
+                    float avg[], unsigned int stride) const
+    {
+        keeper()(*this, osc, threshold, simval, avg, stride);
+    }
+};
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef OFFLOAD_H
+#define OFFLOAD_H
+
+#include "parameters.h"
+#include "corpus.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+
+#pragma omp declare target
+/**
+ * Get the upper 8 bits of the predicted value, the same computation
+ * of Mixer::Score8() on the plain copy of the weights.
+ */
+inline unsigned int OffloadScore8(const Mixer::weights_t &w, float threshold, unsigned int osc)
+{
+    float avg[8] = { 0.f };
+
+    for (int cb = 0; cb < 11; cb++)
+    {
+        const unsigned int level = (osc >> cb) & 1;
+        if (level && w.finite)
+            continue;
+        for (int sb = 0; sb < 8; sb++)
+            avg[sb] += w.rows[cb][level][sb];
+    }
+
+    const float factor = w.topfactor[(osc >> 11) & 1];
+    unsigned int result = 0;
+    for (int sb = 0; sb < 8; sb++)
+    {
+#ifdef __FMA__
+        const float a = std::fma(factor, w.topweights[sb], avg[sb]);
+#else
+        const float a = factor * w.topweights[sb] + avg[sb];
+#endif
+        const bool high = (sb == 7) ? (osc & 0x800) && w.topbitHigh : (osc & (1 << (4 + sb)));
+        const float val = high ? 1.f - (a - w.pulse) / w.norm[sb] : 0.f;
+        if (val > threshold)
+            result |= 1 << sb;
+    }
+    return result;
+}
+#pragma omp end declare target
+
+/**
+ * Scoring of many candidates at once, for sweeps of the parameter space.
+ *
+ * The candidates are scored in full, without the early exit,
+ * in a single OpenMP target region when an accelerator is available,
+ * that is when compiled with offloading enabled (e.g. -foffload=nvptx-none).
+ * All the references of the corpus and the decoded oscillator values
+ * are copied to the device once, when the scorer is created,
+ * so each batch only transfers the weights of the candidates and the scores.
+ * Without an accelerator the candidates are scored on the host threads
+ * with the vector kernels.
+ *
+ * On the host the scores are the same of Parameters::Score(),
+ * on an accelerator the floating point operations may round differently.
+ */
+class BatchScorer
+{
+private:
+    const Corpus &corpus;
+
+    const uint8_t* samples;
+    unsigned int length;
+
+    /// oscillator values of all the 8 waveforms, one after the other
+    const unsigned int* inputs;
+
+    bool offload;
+
+private:
+    std::vector<score_t> ScoreHost(const std::vector<Parameters> &candidates, unsigned int chip, int wave) const
+    {
+        const uint8_t* s = corpus.Get(chip, wave);
+        const ref_vector_t reference(s, s + Corpus::SAMPLES);
+
+        // the 8580 flag doesn't affect the score
+        std::vector<score_t> scores(candidates.size());
+        #pragma omp parallel for schedule(dynamic)
+        for (int c = 0; c < static_cast<int>(candidates.size()); c++)
+            scores[c] = candidates[c].Score(Parameters::engine_t::FLOAT, wave, false, reference, 4096 * 255);
+        return scores;
+    }
+
+#ifdef _OPENMP
+    std::vector<score_t> ScoreDevice(const std::vector<Parameters> &candidates, unsigned int chip, int wave) const
+    {
+        const int count = candidates.size();
+
+        std::vector<Mixer::weights_t> weights(count);
+        std::vector<float> thresholds(count);
+        for (int c = 0; c < count; c++)
+        {
+            candidates[c].GetMixer(wave).GetWeights(weights[c]);
+            thresholds[c] = candidates[c].threshold;
+        }
+
+        std::vector<unsigned int> audible_error(count);
+        std::vector<unsigned int> wrong_bits(count);
+        std::vector<unsigned long long> squares(count);
+
+        const Mixer::weights_t* const w = weights.data();
+        const float* const thr = thresholds.data();
+        unsigned int* const ae = audible_error.data();
+        unsigned int* const wb = wrong_bits.data();
+        unsigned long long* const sq = squares.data();
+
+        const uint8_t* const s = samples;
+        const unsigned int* const in = inputs;
+        const unsigned int n = length;
+        const unsigned int ref = (chip * Corpus::WAVES + Corpus::WaveIndex(wave)) * Corpus::SAMPLES;
+        const unsigned int osc = (wave & 7) * 4096;
+
+        #pragma omp target teams distribute map(to: w[0:count], thr[0:count], s[0:n], in[0:8*4096]) \
+            map(from: ae[0:count], wb[0:count], sq[0:count])
+        for (int c = 0; c < count; c++)
+        {
+            unsigned int error_sum = 0;
+            unsigned int bits = 0;
+            unsigned long long sum = 0;
+
+            #pragma omp parallel for reduction(+:error_sum,bits,sum)
+            for (int j = 0; j < 4096; j++)
+            {
+                const unsigned int simval = OffloadScore8(w[c], thr[c], in[osc + j]);
+                const unsigned int error = simval ^ s[ref + j];
+                error_sum += error;
+                bits += __builtin_popcount(error);
+                sum += simval * simval;
+            }
+
+            ae[c] = error_sum;
+            wb[c] = bits;
+            sq[c] = sum;
+        }
+
+        std::vector<score_t> scores(count);
+        for (int c = 0; c < count; c++)
+        {
+            scores[c].audible_error = audible_error[c];
+            scores[c].wrong_bits = wrong_bits[c];
+            scores[c].rms = std::sqrt(squares[c]/4096.0);
+        }
+        return scores;
+    }
+#endif
+
+public:
+    explicit BatchScorer(const Corpus &corpus) :
+        corpus(corpus),
+        samples(corpus.size() ? corpus.Get(0, 3) : nullptr),
+        length(corpus.size() * Corpus::WAVES * Corpus::SAMPLES),
+        inputs(Parameters::GetInputs(0)),
+#ifdef _OPENMP
+        offload(omp_get_num_devices() > 0)
+#else
+        offload(false)
+#endif
+    {
+        if (offload)
+        {
+            #pragma omp target enter data map(to: samples[0:length], inputs[0:8*4096])
+        }
+    }
+
+    ~BatchScorer()
+    {
+        if (offload)
+        {
+            #pragma omp target exit data map(release: samples[0:length], inputs[0:8*4096])
+        }
+    }
+
+    /**
+     * Whether the candidates are scored on an accelerator.
+     */
+    bool IsOffloaded() const { return offload; }
+
+    BatchScorer(const BatchScorer&) = delete;
+    BatchScorer& operator=(const BatchScorer&) = delete;
+
+    /**
+     * Score all the candidates against the samples of a chip.
+     *
+     * @param chip the index of the chip in the corpus
+     */
+    std::vector<score_t> Score(const std::vector<Parameters> &candidates, unsigned int chip, int wave) const
+    {
+#ifdef _OPENMP
+        if (offload)
+            return ScoreDevice(candidates, chip, wave);
+#endif
+        return ScoreHost(candidates, chip, wave);
+    }
+};
+
+#endif
@@ -0,0 +1,210 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+/*
+ * Text and file output of the model, used by the tools.
+ *
+ * The model itself, in mixer.h, fixed.h, parameters.h and tables.h,
+ * does no I/O so it can be embedded in the emulator.
+ */
+
+#include "parameters.h"
+#include "tables.h"
+
+#include <cctype>
+#include <cstdint>
+
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+/// Formats of the comparison between prediction and reference
+enum class dump_t
+{
+    TEXT,
+    CSV,
+    BINARY
+};
+
+inline std::string GetWrongBitsRate(const score_t &score)
+{
+    std::ostringstream o;
+    o << score.wrong_bits << "/" << score.total_bits;
+    return o.str();
+}
+
+inline std::ostream & operator<<(std::ostream & os, const score_t & foo)
+{
+   os.precision(2);
+   os << foo.audible_error << " (" << std::fixed << GetWrongBitsRate(foo) << ") [RMS: " << foo.rms << "]";
+   return os;
+}
+
+/**
+ * Format the parameters as C++ assignments.
+ */
+inline std::string ToString(const Parameters &p)
+{
+    std::ostringstream ss;
+    ss.precision(flt::max_digits10);
+    ss << "bestparams.threshold = " << p.threshold << "f;" << std::endl;
+    ss << "bestparams.pulsestrength = " << p.pulsestrength << "f;" << std::endl;
+    ss << "bestparams.topbit = " << p.topbit << "f;" << std::endl;
+    ss << "bestparams.distance1 = " << p.distance1 << "f;" << std::endl;
+    ss << "bestparams.distance2 = " << p.distance2 << "f;" << std::endl;
+    return ss.str();
+}
+
+/**
+ * Write the comparison between the values predicted by the parameters and the reference.
+ *
+ * The text format has a line for each value with the index, the
+ * waveform selector input, the reference, the prediction and
+ * their difference, in hex.
+ * The CSV format has the same fields in decimal, with a header.
+ * The binary format is the magic "CWD1" followed by the 4096
+ * reference values and then the 4096 predicted ones.
+ */
+inline void Dump(const Parameters &params, int wave, const ref_vector_t &reference, dump_t format, std::ostream &out)
+{
+    uint8_t table[4096];
+    params.GetTable(wave, table);
+
+    if (format == dump_t::BINARY)
+    {
+        out.write("CWD1", 4);
+        out.write(reinterpret_cast<const char*>(reference.data()), 4096);
+        out.write(reinterpret_cast<const char*>(table), 4096);
+        return;
+    }
+
+    // format everything in memory and write it at once
+    std::ostringstream ss;
+    if (format == dump_t::CSV)
+        ss << "index,osc,reference,simulated,diff\n";
+    else
+        ss << std::hex << std::setfill('0');
+
+    for (unsigned int j = 0; j < 4096; j++)
+    {
+        const unsigned int osc = Parameters::GetOsc(wave, j);
+        const unsigned int refval = reference[j];
+        const unsigned int simval = table[j];
+        if (format == dump_t::CSV)
+        {
+            ss << j << "," << osc << "," << refval << "," << simval << "," << (simval ^ refval) << "\n";
+        }
+        else
+        {
+            ss << std::setw(3) << j << " "
+               << std::setw(3) << osc << " "
+               << std::setw(2) << refval << " "
+               << std::setw(2) << simval << " "
+               << std::setw(2) << (simval ^ refval) << " "
+               << "\n";
+        }
+    }
+    out << ss.str();
+}
+
+/**
+ * Write the tables as a binary blob:
+ *
+ *     char     magic[4]            "CWT1"
+ *     uint8_t  digital[4][4096]
+ *     uint8_t  analog[4][4096][2]  optional, little endian
+ *
+ * with the magic being "CWTA" when the analog tables are present.
+ */
+inline void WriteTablesBinary(const tables_t &tables, std::ostream &out)
+{
+    out.write(tables.hasAnalog ? "CWTA" : "CWT1", 4);
+    out.write(reinterpret_cast<const char*>(tables.digital), sizeof(tables.digital));
+    if (tables.hasAnalog)
+    {
+        for (unsigned int w = 0; w < tables_t::WAVES; w++)
+        {
+            for (unsigned int j = 0; j < 4096; j++)
+            {
+                const char bytes[2] =
+                {
+                    static_cast<char>(tables.analog[w][j] & 0xff),
+                    static_cast<char>(tables.analog[w][j] >> 8)
+                };
+                out.write(bytes, 2);
+            }
+        }
+    }
+}
+
+/**
+ * Write the tables as a C++ header with constexpr arrays.
+ *
+ * @param name the chip name, used to build the identifiers
+ */
+inline void WriteTablesHeader(const tables_t &tables, const char* name, std::ostream &out)
+{
+    std::string id = "combined_";
+    for (const char* c = name; *c; c++)
+        id += isalnum(static_cast<unsigned char>(*c)) ? *c : '_';
+
+    out << "// Combined waveforms tables for chip " << name << std::endl
+        << "// generated from the model parameters, waveforms 3, 5, 6 and 7" << std::endl
+        << std::endl
+        << "#include <cstdint>" << std::endl
+        << std::endl
+        << "constexpr uint8_t " << id << "[4][4096] =" << std::endl
+        << "{" << std::endl;
+    for (unsigned int w = 0; w < tables_t::WAVES; w++)
+    {
+        out << "    {";
+        for (unsigned int j = 0; j < 4096; j++)
+        {
+            out << ((j % 16) ? " " : "\n        ")
+                << static_cast<unsigned int>(tables.digital[w][j]) << ",";
+        }
+        out << std::endl << "    }," << std::endl;
+    }
+    out << "};" << std::endl;
+
+    if (tables.hasAnalog)
+    {
+        out << std::endl
+            << "constexpr uint16_t " << id << "_analog[4][4096] =" << std::endl
+            << "{" << std::endl;
+        for (unsigned int w = 0; w < tables_t::WAVES; w++)
+        {
+            out << "    {";
+            for (unsigned int j = 0; j < 4096; j++)
+            {
+                out << ((j % 16) ? " " : "\n        ")
+                    << tables.analog[w][j] << ",";
+            }
+            out << std::endl << "    }," << std::endl;
+        }
+        out << "};" << std::endl;
+    }
+}
+
+#endif
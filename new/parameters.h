@@ -22,12 +22,15 @@
 #ifndef PARAMETERS_H
 #define PARAMETERS_H
 
+#include "mixer.h"
+#include "fixed.h"
+
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 
 #include <vector>
-#include <string>
-#include <sstream>
-#include <iomanip>
+#include <algorithm>
 #include <limits>
 
 typedef std::numeric_limits<float> flt;
@@ -47,7 +50,114 @@ inline Param_t& operator++(Param_t& x, int)
     return x = static_cast<Param_t>(static_cast<std::underlying_type<Param_t>::type>(x) + 1);
 }
 
-typedef std::vector<unsigned int> ref_vector_t;
+constexpr unsigned int PARAMS = static_cast<unsigned int>(Param_t::DISTANCE2) + 1;
+
+inline const char* GetParamName(Param_t p)
+{
+    switch (p)
+    {
+    case Param_t::THRESHOLD: return "threshold";
+    case Param_t::PULSESTRENGTH: return "pulsestrength";
+    case Param_t::TOPBIT: return "topbit";
+    case Param_t::DISTANCE1: return "distance1";
+    default: return "distance2";
+    }
+}
+
+/**
+ * Get the parameter from its name.
+ *
+ * @return false if the name is unknown
+ */
+inline bool ParseParamName(const char* name, Param_t &p)
+{
+    for (Param_t i = Param_t::THRESHOLD; i <= Param_t::DISTANCE2; i++)
+    {
+        if (strcmp(name, GetParamName(i)) == 0)
+        {
+            p = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Distance functions
+enum class Distance_t
+{
+    EXPONENTIAL,
+    LINEAR,
+    QUADRATIC
+};
+
+constexpr unsigned int DISTANCES = static_cast<unsigned int>(Distance_t::QUADRATIC) + 1;
+
+inline const char* GetDistanceName(Distance_t d)
+{
+    switch (d)
+    {
+    case Distance_t::LINEAR: return "linear";
+    case Distance_t::QUADRATIC: return "quadratic";
+    default: return "exponential";
+    }
+}
+
+/**
+ * Get the distance function from its name.
+ *
+ * @return false if the name is unknown
+ */
+inline bool ParseDistanceName(const char* name, Distance_t &d)
+{
+    for (Distance_t f : { Distance_t::EXPONENTIAL, Distance_t::LINEAR, Distance_t::QUADRATIC })
+    {
+        if (strcmp(name, GetDistanceName(f)) == 0)
+        {
+            d = f;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Calculate the weight as a function of distance, for distances from 1 to 12.
+ */
+template<Distance_t D>
+inline void DistanceCurve(float distance, float w[13]);
+
+template<>
+inline void DistanceCurve<Distance_t::EXPONENTIAL>(float distance, float w[13])
+{
+    // distance^-i, the power is built incrementally in double precision
+    // which gives the same results of pow() once rounded to float
+    double v = 1.;
+    for (int i = 1; i <= 12; i++)
+    {
+        v *= distance;
+        w[i] = static_cast<float>(1. / v);
+    }
+}
+
+template<>
+inline void DistanceCurve<Distance_t::LINEAR>(float distance, float w[13])
+{
+    for (int i = 1; i <= 12; i++)
+        w[i] = 1.f / (1.f + i * distance);
+}
+
+template<>
+inline void DistanceCurve<Distance_t::QUADRATIC>(float distance, float w[13])
+{
+    for (int i = 1; i <= 12; i++)
+        w[i] = 1.f / (1.f + (i*i) * distance);
+}
+
+/// Sampled values of a combined waveform
+typedef std::vector<uint8_t> ref_vector_t;
+
+/// Order in which the oscillator values are scored
+typedef std::vector<unsigned int> order_vector_t;
 
 struct score_t
 {
@@ -58,20 +168,17 @@ struct score_t
 
     double rms;
 
+    /// number of values scored, less than 4096 if the scoring stopped early
+    unsigned int samples;
+
     score_t() :
         audible_error(0),
         wrong_bits(0),
         total_bits(4096*8),
-        rms(0.)
+        rms(0.),
+        samples(4096)
     {}
 
-    std::string wrongBitsRate() const
-    {
-        std::ostringstream o;
-        o << wrong_bits << "/" << total_bits;
-        return o.str();
-    }
-
     bool isBetter(const score_t& newScore) const
     {
         return (newScore.audible_error < audible_error)
@@ -80,37 +187,139 @@ struct score_t
     }
 };
 
-std::ostream & operator<<(std::ostream & os, const score_t & foo)
+/**
+ * Histograms of the predicted values and of the errors of the scored
+ * oscillator values, from which all the components of the score
+ * are derived in a single pass over the bins at the end.
+ *
+ * The zero bins, by far the most frequent, are not counted:
+ * they add nothing to the score and incrementing the same counter
+ * over and over stalls on the memory dependency.
+ * They are the number of samples minus the other bins.
+ */
+struct histogram_t
 {
-   os.precision(2);
-   os << foo.audible_error << " (" << std::fixed << foo.wrongBitsRate() << ") [RMS: " << foo.rms << "]";
-   return os;
-}
+    unsigned int simulated[256];
+    unsigned int error[256];
+    unsigned int samples;
+
+    histogram_t() :
+        simulated(),
+        error(),
+        samples(0)
+    {}
 
-class Parameters
-{
-private:
-    typedef float (*distance_t)(float, int);
+    void Add(unsigned int simval, unsigned int refval)
+    {
+        const unsigned int e = simval ^ refval;
+        if (simval)
+            simulated[simval]++;
+        if (e)
+            error[e]++;
+    }
 
-public:
-    // Distance functions
-    static float exponentialDistance(float distance, int i)
+    void Merge(const histogram_t &other)
     {
-        return pow(distance, -i);
+        for (unsigned int v = 0; v < 256; v++)
+        {
+            simulated[v] += other.simulated[v];
+            error[v] += other.error[v];
+        }
+        samples += other.samples;
     }
 
-    static float linearDistance(float distance, int i)
+    /**
+     * Count number of mispredicted bits.
+     */
+    static unsigned int WrongBits(unsigned int v)
     {
-        return 1.f / (1.f + i * distance);
+#ifdef __GNUC__
+        return __builtin_popcount(v);
+#else
+        // Brian Kernighan's method, goes through as many iterations as there are set bits
+        unsigned int c = 0;
+        for (; v; c++)
+        {
+          v &= v - 1;
+        }
+        return c;
+#endif
     }
 
-    static float quadraticDistance(float distance, int i)
+    score_t GetScore() const
     {
-        return 1.f / (1.f + (i*i) * distance);
+        score_t score;
+        score.samples = samples;
+
+        // the sum of the squares is an integer, exact in a double
+        double sum = 0.;
+        for (unsigned int v = 0; v < 256; v++)
+        {
+            score.audible_error += v * error[v];
+            score.wrong_bits += WrongBits(v) * error[v];
+            sum += static_cast<double>(v * v) * simulated[v];
+        }
+        score.rms = std::sqrt(sum/4096.0);
+        return score;
+    }
+};
+
+#pragma omp declare reduction(merge : histogram_t : omp_out.Merge(omp_in))
+
+/**
+ * Weight rows accumulated by the floating point model for all the
+ * oscillator values of a waveform. They depend only on the distance
+ * function and parameters, so candidates which differ from the cached
+ * parameters just in threshold, pulse strength or top bit are scored
+ * without redoing the mix.
+ * The rows are either all computed at once, or each one the first time
+ * its value is scored.
+ */
+struct mix_cache_t
+{
+    int wave;
+    Distance_t distFunc;
+    float distance1;
+    float distance2;
+
+    /// rows of the output bit 4+sb of the value j at avg[sb * 4096 + j], empty until filled
+    std::vector<float> avg;
+
+    /// whether the rows of the value j have been computed
+    std::vector<uint8_t> filled;
+
+    mix_cache_t() :
+        wave(0),
+        distFunc(Distance_t::EXPONENTIAL),
+        distance1(0.f),
+        distance2(0.f)
+    {}
+};
+
+class Parameters
+{
+public:
+    /// Scoring engines
+    enum class engine_t
+    {
+        /// the floating point model, the reference
+        FLOAT,
+        /// the fixed point approximation, see FixedMixer
+        FIXED
+    };
+
+private:
+    /// Number of oscillator values scored between checks of the bound
+    static constexpr unsigned int CHUNK = 128;
+
+    static engine_t& engine()
+    {
+        static engine_t e = engine_t::FLOAT;
+        return e;
     }
 
 public:
-    distance_t distFunc;
+    Distance_t distFunc;
     float threshold;
     float pulsestrength;
     float topbit;
@@ -122,6 +331,7 @@ public:
 
     void reset()
     {
+        distFunc = Distance_t::EXPONENTIAL;
         threshold = 0.9f;
         pulsestrength = 1.f;
         topbit = 1.f;
@@ -129,7 +339,7 @@ public:
         distance2 = 1.f;
     }
 
-    float GetValue(Param_t i)
+    float GetValue(Param_t i) const
     {
         switch (i)
         {
@@ -154,115 +364,202 @@ public:
         }
     }
 
-    std::string toString()
+private:
+    /**
+     * Calculate audible error.
+     */
+    static unsigned int ScoreResult(unsigned int a, unsigned int b)
     {
-        std::ostringstream ss;
-        ss.precision(flt::max_digits10);
-        ss << "bestparams.threshold = " << threshold << "f;" << std::endl;
-        ss << "bestparams.pulsestrength = " << pulsestrength << "f;" << std::endl;
-        ss << "bestparams.topbit = " << topbit << "f;" << std::endl;
-        ss << "bestparams.distance1 = " << distance1 << "f;" << std::endl;
-        ss << "bestparams.distance2 = " << distance2 << "f;" << std::endl;
-        return ss.str();
+        return a ^ b;
     }
 
-private:
-    void SimulateMix(float bitarray[12], float wa[], bool HasPulse) const
+public:
+    /**
+     * Get the waveform selector input for the given oscillator value.
+     */
+    static unsigned int GetOsc(int wave, unsigned int j)
     {
-        float pulldown[12];
+        // saw/tri: if saw is not selected the bits are XORed
+        unsigned int osc =
+            (wave & 2) ? j : ((j & 0x800) == 0 ? j : (j ^ 0xfff)) << 1;
+
+        // saw+tri
+        // If both Saw and Triangle are selected the bits are interconnected
+        //
+        // @NOTE: on the 8580 the triangle selector transistors, with the exception 
+        // of the lowest four bits, are half the width of the other selectors.
+        // How does this affects combined waveforms?
+
+        if ((wave & 3) == 3)
+        {
+            /*
+            * Enabling the S waveform pulls the XOR circuit selector transistor down
+            * (which would normally make the descending ramp of the triangle waveform),
+            * so ST does not actually have a sawtooth and triangle waveform combined,
+            * but merely combines two sawtooths, one rising double the speed the other.
+            *
+            * http://www.lemon64.com/forum/viewtopic.php?t=25442&postdays=0&postorder=asc&start=165
+            */
+            osc &= osc << 1;
+        }
 
-        for (int sb = 0; sb < 12; sb++)
+        return osc;
+    }
+
+    /**
+     * Get the waveform selector inputs of all the oscillator values,
+     * decoded once for each waveform and shared by all the candidates.
+     * The inputs of the 8 waveforms follow one another.
+     */
+    static const unsigned int* GetInputs(int wave)
+    {
+        struct inputs_t
         {
-            float n = 0.f;
-            float avg = 0.f;
-#if 1
-            for (int cb = 0; cb < 12; cb++)
-            {
-                if (cb == sb)
-                    continue;
-                const float weight = wa[sb - cb + 12];
-                avg += (1.f - bitarray[cb]) * weight;
-                n += weight;
-            }
-#else
-            if (sb > 0)
-            {
-                for (int cb = sb-1; cb >= 0; cb--)
-                {
-                    //if (bitarray[cb] == 1.f)
-                    //    break;
-                    const float weight = wa[sb - cb + 12];
-                    avg += weight;
-                    n += 1.f;
-                }
-            }
-            if (sb < 11)
-            {
-                for (int cb = sb+1; cb < 12; cb++)
-                {
-                    //if (bitarray[cb] == 1.f)
-                    //    break;
-                    const float weight = wa[sb - cb + 12];
-                    avg += weight;
-                    n += 1.f;
-                }
-            }
-#endif
-            if (HasPulse)
+            unsigned int osc[8][4096];
+
+            inputs_t()
             {
-#if 1
-                avg -= pulsestrength;
-#else
-                const float weight = wa[sb];
-                avg += (1.f - pulsestrength) * weight;
-                n += weight;
-#endif
+                for (int w = 0; w < 8; w++)
+                    for (unsigned int j = 0; j < 4096; j++)
+                        osc[w][j] = GetOsc(w, j);
             }
-            pulldown[sb] = avg / n;
-        }
-        for (int i = 0; i < 12; i++)
-            if (bitarray[i] != 0.f)
-                bitarray[i] = 1.f - pulldown[i];
+        };
+        static const inputs_t inputs;
+        return inputs.osc[wave & 7];
     }
 
+private:
     /**
-     * Get the upper 8 bits of the predicted value.
+     * Get the inputs of the batch starting from b, in the given order if any.
+     * Without an order the inputs are used in place.
      */
-    unsigned int GetScore8(float bitarray[12]) const
+    static const unsigned int* GetBatch(const unsigned int* inputs, unsigned int b, const order_vector_t *order,
+                                        unsigned int index[Mixer::BATCH], unsigned int osc[Mixer::BATCH])
     {
-        unsigned int result = 0;
-        for (int cb = 0; cb < 8; cb++)
-        {
-            if (bitarray[4+cb] > threshold)
-                result |= 1 << cb;
-        }
-        return result;
+        for (unsigned int i = 0; i < Mixer::BATCH; i++)
+            index[i] = order ? (*order)[b + i] : b + i;
+
+        if (!order)
+            return inputs + b;
+
+        for (unsigned int i = 0; i < Mixer::BATCH; i++)
+            osc[i] = inputs[index[i]];
+        return osc;
     }
 
+    /// The mixer predicting from the rows of the cache
+    struct cached_mixer_t
+    {
+        Mixer mixer;
+        float* avg;
+        uint8_t* filled;
+    };
+
     /**
-     * Calculate audible error.
+     * Predict the batch of values starting from b.
      */
-    static unsigned int ScoreResult(unsigned int a, unsigned int b)
+    template<class M>
+    void Predict(const M &mixer, const unsigned int osc[Mixer::BATCH], const unsigned int*, unsigned int,
+                 const order_vector_t*, unsigned int simval[Mixer::BATCH]) const
     {
-        return a ^ b;
+        mixer.Score8(osc, threshold, simval);
+    }
+
+    void Predict(const cached_mixer_t &cached, const unsigned int osc[Mixer::BATCH], const unsigned int index[Mixer::BATCH],
+                 unsigned int b, const order_vector_t *order, unsigned int simval[Mixer::BATCH]) const
+    {
+        bool filled = true;
+        if (!order)
+        {
+            // all the flags of the batch at once
+            uint64_t flags[Mixer::BATCH / 8];
+            std::memcpy(flags, cached.filled + b, sizeof(flags));
+            for (unsigned int w = 0; w < Mixer::BATCH / 8; w++)
+                filled = filled && (flags[w] == 0x0101010101010101ULL);
+        }
+        else
+        {
+            for (unsigned int i = 0; i < Mixer::BATCH; i++)
+                filled = filled && cached.filled[index[i]];
+        }
+
+        // score the batch, as a full scoring would, keeping its rows;
+        // each value is scored by a single thread, so the writes never race
+        if (!filled && !order)
+        {
+            cached.mixer.Score8Keep(osc, threshold, simval, cached.avg + b, 4096);
+            std::memset(cached.filled + b, 1, Mixer::BATCH);
+            return;
+        }
+
+        if (!filled)
+        {
+            float avg[8 * Mixer::BATCH];
+            cached.mixer.Score8Keep(osc, threshold, simval, avg, Mixer::BATCH);
+            for (unsigned int i = 0; i < Mixer::BATCH; i++)
+            {
+                for (unsigned int sb = 0; sb < 8; sb++)
+                    cached.avg[sb * 4096 + index[i]] = avg[sb * Mixer::BATCH + i];
+                cached.filled[index[i]] = 1;
+            }
+            return;
+        }
+
+        if (!order)
+        {
+            cached.mixer.Score8(osc, cached.avg + b, 4096, threshold, simval);
+            return;
+        }
+
+        float avg[8 * Mixer::BATCH];
+        for (unsigned int sb = 0; sb < 8; sb++)
+            for (unsigned int i = 0; i < Mixer::BATCH; i++)
+                avg[sb * Mixer::BATCH + i] = cached.avg[sb * 4096 + index[i]];
+        cached.mixer.Score8(osc, avg, Mixer::BATCH, threshold, simval);
     }
 
     /**
-     * Count number of mispredicted bits.
+     * Add the predicted values of a batch to the histograms.
+     *
+     * @return the audible error of the batch
      */
-    static unsigned int WrongBits(unsigned int v)
+    static unsigned int AddBatch(const unsigned int simval[Mixer::BATCH], const unsigned int index[Mixer::BATCH],
+                                 const ref_vector_t &reference, histogram_t &histogram)
     {
-        // Brian Kernighan's method, goes through as many iterations as there are set bits
-        unsigned int c = 0;
-        for (; v; c++)
+        unsigned int audible_error = 0;
+        for (unsigned int i = 0; i < Mixer::BATCH; i++)
         {
-          v &= v - 1;
+            const unsigned int refval = reference[index[i]];
+            audible_error += ScoreResult(simval[i], refval);
+            histogram.Add(simval[i], refval);
         }
-        return c;
+        histogram.samples += Mixer::BATCH;
+        return audible_error;
     }
 
-    float getAnalogValue(float bitarray[12]) const
+    /**
+     * Score a batch of oscillator values starting from b,
+     * adding them to the histograms.
+     *
+     * @return the audible error of the batch
+     */
+    template<class M>
+    unsigned int ScoreBatch(const M &mixer, const unsigned int* inputs, const ref_vector_t &reference,
+                            unsigned int b, const order_vector_t *order, histogram_t &histogram) const
     {
+        unsigned int index[Mixer::BATCH];
+        unsigned int osc[Mixer::BATCH];
+        unsigned int simval[Mixer::BATCH];
+
+        Predict(mixer, GetBatch(inputs, b, order, index, osc), index, b, order, simval);
+        return AddBatch(simval, index, reference, histogram);
+    }
+
+    float getAnalogValue(const Mixer &mixer, unsigned int osc) const
+    {
+        float bitarray[12];
+        mixer.Simulate(osc, bitarray);
+
         float analogval = 0.f;
         for (unsigned int i = 0; i < 12; i++)
         {
@@ -271,125 +568,441 @@ private:
                 val = 0.f;
             else if (val > 1.f)
                 val = 1.f;
-            analogval += ldexp(val, i);
+            analogval += val * static_cast<float>(1 << i);
         }
         return analogval / 16.f;
     }
 
-public:
-    score_t Score(int wave, bool is8580, const ref_vector_t &reference, bool print, unsigned int bestscore)
+    /**
+     * Calculate the weight as a function of distance,
+     * wa[12] being the bit itself.
+     *
+     * TODO: try to come up with a generic distance function to
+     * cover all scenarios...
+     */
+    template<Distance_t D>
+    void GetWeights(float wa[12 * 2 + 1]) const
     {
-        /*
-         * Calculate the weight as a function of distance.
-         *
-         * TODO: try to come up with a generic distance function to
-         * cover all scenarios...
-         */
-        float wa[12 * 2 + 1];
+        float w1[13];
+        float w2[13];
+        DistanceCurve<D>(distance1, w1);
+        DistanceCurve<D>(distance2, w2);
+
         wa[12] = 1.f;
         for (int i = 12; i > 0; i--)
         {
-            wa[12-i] = distFunc(distance1, i);
-            wa[12+i] = distFunc(distance2, i);
+            wa[12-i] = w1[i];
+            wa[12+i] = w2[i];
         }
+    }
 
-        score_t score;
+    /**
+     * Get the topbit multiplier for the given waveform.
+     */
+    float GetTopbit(int wave) const
+    {
+        // topbit for Saw
+        // Why does this happen?
+        // For 6581 this is mostly 0 while for 8580 it's near 1
+        // A few 'odd' 6581 chips show a strangely high value
+        // for Pulse-Saw combination
+        return (wave & 2) ? topbit : 1.f;
+    }
 
-        bool done = false;
+public:
+    /**
+     * Build the mixer for the given waveform and distance function.
+     */
+    template<Distance_t D>
+    Mixer GetMixer(int wave) const
+    {
+        float wa[12 * 2 + 1];
+        GetWeights<D>(wa);
+        return Mixer(wa, pulsestrength, GetTopbit(wave), wave & 4);
+    }
+
+    /**
+     * Build the fixed point mixer for the given waveform and distance function.
+     */
+    template<Distance_t D>
+    FixedMixer GetFixedMixer(int wave) const
+    {
+        float wa[12 * 2 + 1];
+        GetWeights<D>(wa);
+        return FixedMixer(wa, pulsestrength, GetTopbit(wave), wave & 4, threshold);
+    }
+
+public:
+    /**
+     * Build the mixer for the given waveform.
+     */
+    Mixer GetMixer(int wave) const
+    {
+        switch (distFunc)
+        {
+        case Distance_t::LINEAR: return GetMixer<Distance_t::LINEAR>(wave);
+        case Distance_t::QUADRATIC: return GetMixer<Distance_t::QUADRATIC>(wave);
+        default: return GetMixer<Distance_t::EXPONENTIAL>(wave);
+        }
+    }
+
+    /**
+     * Build the fixed point mixer for the given waveform.
+     */
+    FixedMixer GetFixedMixer(int wave) const
+    {
+        switch (distFunc)
+        {
+        case Distance_t::LINEAR: return GetFixedMixer<Distance_t::LINEAR>(wave);
+        case Distance_t::QUADRATIC: return GetFixedMixer<Distance_t::QUADRATIC>(wave);
+        default: return GetFixedMixer<Distance_t::EXPONENTIAL>(wave);
+        }
+    }
+
+    /**
+     * Select the engine used by the scoring and the predicted tables,
+     * the floating point one by default.
+     * The analog tables always use the floating point model.
+     */
+    static void UseEngine(engine_t e)
+    {
+        engine() = e;
+    }
+
+    static engine_t GetEngine()
+    {
+        return engine();
+    }
+
+public:
+    /**
+     * Get the predicted upper 8 bits for all the 4096 oscillator values.
+     */
+    void GetTable(int wave, uint8_t table[4096]) const
+    {
+        if (engine() == engine_t::FIXED)
+            GetTable(GetFixedMixer(wave), wave, table);
+        else
+            GetTable(GetMixer(wave), wave, table);
+    }
+
+    /**
+     * Get the predicted 12 bit analog values for all the 4096 oscillator values.
+     */
+    void GetAnalogTable(int wave, uint16_t table[4096]) const
+    {
+        const Mixer mixer = GetMixer(wave);
 
-        double sum = 0.;
-        // loop over the 4096 oscillator values
-        #pragma omp parallel for ordered
         for (unsigned int j = 0; j < 4096; j++)
         {
-            #pragma omp flush(done)
-            if (!done)
+            const long val = std::lround(getAnalogValue(mixer, GetOsc(wave, j)) * 16.f);
+            table[j] = static_cast<uint16_t>(std::min(std::max(val, 0L), 4095L));
+        }
+    }
+
+    /**
+     * Get the sample order which scores first the oscillator values
+     * with the biggest error for these parameters,
+     * so that worse candidates exceed the bound sooner.
+     */
+    order_vector_t GetSampleOrder(int wave, const ref_vector_t &reference) const
+    {
+        uint8_t table[4096];
+        GetTable(wave, table);
+
+        unsigned int errors[4096];
+        for (unsigned int j = 0; j < 4096; j++)
+            errors[j] = ScoreResult(table[j], reference[j]);
+
+        order_vector_t order(4096);
+        for (unsigned int j = 0; j < 4096; j++)
+            order[j] = j;
+        std::stable_sort(order.begin(), order.end(),
+            [&errors](unsigned int a, unsigned int b) { return errors[a] > errors[b]; });
+        return order;
+    }
+
+    /**
+     * Score the parameters against the reference.
+     *
+     * @param bestscore stop as soon as the audible error exceeds this bound
+     * @param order optional order in which the values are scored
+     */
+    score_t Score(int wave, bool is8580, const ref_vector_t &reference, unsigned int bestscore,
+                  const order_vector_t *order = nullptr) const
+    {
+        return Score(engine(), wave, is8580, reference, bestscore, order);
+    }
+
+    /**
+     * Score the parameters with the given engine,
+     * regardless of the selected one.
+     */
+    score_t Score(engine_t e, int wave, bool is8580, const ref_vector_t &reference, unsigned int bestscore,
+                  const order_vector_t *order = nullptr) const
+    {
+        return (e == engine_t::FIXED)
+            ? Score(GetFixedMixer(wave), wave, reference, bestscore, order)
+            : Score(GetMixer(wave), wave, reference, bestscore, order);
+    }
+
+    /**
+     * Whether the cache holds the rows of these distances.
+     */
+    bool Matches(const mix_cache_t &cache, int wave) const
+    {
+        return !cache.avg.empty()
+            && (cache.wave == wave)
+            && (cache.distFunc == distFunc)
+            && (cache.distance1 == distance1)
+            && (cache.distance2 == distance2);
+    }
+
+    /**
+     * Make the cache hold the rows of these parameters, computed lazily
+     * the first time each value is scored, unless it already holds them
+     * or the fixed point engine is used.
+     * Only a cache filled with FillCache() can be shared by concurrent scorings.
+     */
+    void ResetCache(int wave, mix_cache_t &cache) const
+    {
+        if ((engine() != engine_t::FLOAT) || Matches(cache, wave))
+            return;
+
+        cache.avg.resize(8 * 4096);
+        cache.filled.assign(4096, 0);
+        cache.wave = wave;
+        cache.distFunc = distFunc;
+        cache.distance1 = distance1;
+        cache.distance2 = distance2;
+    }
+
+    /**
+     * Fill the cache with all the rows of these parameters,
+     * unless it already holds them or the fixed point engine is used.
+     */
+    void FillCache(int wave, mix_cache_t &cache) const
+    {
+        if ((engine() != engine_t::FLOAT)
+            || (Matches(cache, wave) && std::all_of(cache.filled.begin(), cache.filled.end(), [](uint8_t f) { return f; })))
+            return;
+
+        const Mixer mixer = GetMixer(wave);
+        const unsigned int* inputs = GetInputs(wave);
+
+        // row by row over all the values, which vectorizes,
+        // adding in the same order of Mixer::Accumulate()
+        cache.avg.assign(8 * 4096, 0.f);
+        for (int cb = 0; cb < 11; cb++)
+        {
+            for (unsigned int sb = 0; sb < 8; sb++)
             {
-                // saw/tri: if saw is not selected the bits are XORed
-                unsigned int osc =
-                    (wave & 2) ? j : ((j & 0x800) == 0 ? j : (j ^ 0xfff)) << 1;
-
-                // saw+tri
-                // If both Saw and Triangle are selected the bits are interconnected
-                //
-                // @NOTE: on the 8580 the triangle selector transistors, with the exception 
-                // of the lowest four bits, are half the width of the other selectors.
-                // How does this affects combined waveforms?
-
-                if ((wave & 3) == 3)
-                {
-                    /*
-                    * Enabling the S waveform pulls the XOR circuit selector transistor down
-                    * (which would normally make the descending ramp of the triangle waveform),
-                    * so ST does not actually have a sawtooth and triangle waveform combined,
-                    * but merely combines two sawtooths, one rising double the speed the other.
-                    *
-                    * http://www.lemon64.com/forum/viewtopic.php?t=25442&postdays=0&postorder=asc&start=165
-                    */
-                    osc &= osc << 1;
-                }
+                const float low = mixer.GetRow(cb, 0, 4 + sb);
+                const float high = mixer.GetRow(cb, 1, 4 + sb);
+                float* const avg = cache.avg.data() + sb * 4096;
+                for (unsigned int j = 0; j < 4096; j++)
+                    avg[j] += ((inputs[j] >> cb) & 1) ? high : low;
+            }
+        }
+        cache.filled.assign(4096, 1);
 
-                // Get the analogic values
-                float bitarray[12];
+        cache.wave = wave;
+        cache.distFunc = distFunc;
+        cache.distance1 = distance1;
+        cache.distance2 = distance2;
+    }
 
-                for (unsigned int i = 0; i < 12; i++)
-                {
-                    bitarray[i] = (osc & (1 << i)) != 0 ? 1.f : 0.f;
-                }
+    /**
+     * Score the parameters re-using the cached rows when they have the same distances,
+     * with the same result of a full scoring, and adding the missing rows of the scored values.
+     * The fixed point engine doesn't use the cache.
+     */
+    score_t Score(int wave, bool is8580, const ref_vector_t &reference, unsigned int bestscore,
+                  const order_vector_t *order, mix_cache_t &cache) const
+    {
+        if ((engine() != engine_t::FLOAT) || !Matches(cache, wave))
+            return Score(wave, is8580, reference, bestscore, order);
 
-                // topbit for Saw
-                if ((wave & 2) == 2)
-                {
-                    // Why does this happen?
-                    // For 6581 this is mostly 0 while for 8580 it's near 1
-                    // A few 'odd' 6581 chips show a strangely high value
-                    // for Pulse-Saw combination
-                    bitarray[11] *= topbit;
-                }
+        const cached_mixer_t cached = { GetMixer(wave), cache.avg.data(), cache.filled.data() };
+        return Score(cached, wave, reference, bestscore, order);
+    }
 
-                SimulateMix(bitarray, wa, wave & 4);
+    /**
+     * Score the parameters with each of the distance functions at once,
+     * decoding the oscillator values only once for all of them.
+     * Each function stops being scored as soon as its audible error
+     * exceeds the bound.
+     *
+     * @param scores the resulting scores, indexed by Distance_t
+     */
+    void ScoreDistances(int wave, bool is8580, const ref_vector_t &reference, unsigned int bestscore,
+                        const order_vector_t *order, score_t scores[DISTANCES]) const
+    {
+        if (engine() == engine_t::FIXED)
+        {
+            const FixedMixer mixers[DISTANCES] =
+            {
+                GetFixedMixer<Distance_t::EXPONENTIAL>(wave),
+                GetFixedMixer<Distance_t::LINEAR>(wave),
+                GetFixedMixer<Distance_t::QUADRATIC>(wave)
+            };
+            ScoreDistances(mixers, wave, reference, bestscore, order, scores);
+        }
+        else
+        {
+            const Mixer mixers[DISTANCES] =
+            {
+                GetMixer<Distance_t::EXPONENTIAL>(wave),
+                GetMixer<Distance_t::LINEAR>(wave),
+                GetMixer<Distance_t::QUADRATIC>(wave)
+            };
+            ScoreDistances(mixers, wave, reference, bestscore, order, scores);
+        }
+    }
 
-                // Calculate score
-                const unsigned int simval = GetScore8(bitarray);
-                const unsigned int refval = reference[j];
-                unsigned int error = ScoreResult(simval, refval);
-                double const x = simval * simval;
-                #pragma omp atomic
-                sum += x;
+private:
+    template<class M>
+    void GetTable(const M &mixer, int wave, uint8_t table[4096]) const
+    {
+        const unsigned int* inputs = GetInputs(wave);
 
-                #pragma omp atomic
-                score.audible_error += error;
-                #pragma omp atomic
-                score.wrong_bits += WrongBits(error);
+        for (unsigned int b = 0; b < 4096; b += Mixer::BATCH)
+        {
+            unsigned int simval[Mixer::BATCH];
+            mixer.Score8(inputs + b, threshold, simval);
+            for (unsigned int i = 0; i < Mixer::BATCH; i++)
+                table[b + i] = simval[i];
+        }
+    }
+
+    template<class M>
+    score_t Score(const M &mixer, int wave, const ref_vector_t &reference, unsigned int bestscore,
+                  const order_vector_t *order) const
+    {
+        const unsigned int* inputs = GetInputs(wave);
+
+        bool done = false;
+
+        // per thread histograms, combined at the end of the loop
+        histogram_t histogram;
+
+        /*
+         * Bounded scoring: the values are scored in chunks and the
+         * running total is checked against the bound after each one,
+         * all threads stop picking new chunks as soon as it is exceeded.
+         */
+        unsigned int next = 0;
+        unsigned int running_error = 0;
+
+        #pragma omp parallel reduction(merge:histogram)
+        for (;;)
+        {
+            unsigned int chunk;
+            #pragma omp atomic capture
+            chunk = next++;
+            if (chunk >= 4096 / CHUNK)
+                break;
+
+            bool halt;
+            #pragma omp atomic read
+            halt = done;
+            if (halt)
+                break;
+
+            unsigned int chunk_error = 0;
+            for (unsigned int b = chunk * CHUNK; b < (chunk + 1) * CHUNK; b += Mixer::BATCH)
+            {
+                chunk_error += ScoreBatch(mixer, inputs, reference, b, order, histogram);
+            }
 
-                if (print)
+            unsigned int running;
+            #pragma omp atomic capture
+            running = running_error += chunk_error;
+
+            // halt if we already are worst than the best score
+            if (running > bestscore)
+            {
+                #pragma omp atomic write
+                done = true;
+                break;
+            }
+        }
+
+        return histogram.GetScore();
+    }
+
+    template<class M>
+    void ScoreDistances(const M mixers[DISTANCES], int wave, const ref_vector_t &reference, unsigned int bestscore,
+                        const order_vector_t *order, score_t scores[DISTANCES]) const
+    {
+        const unsigned int* inputs = GetInputs(wave);
+
+        bool done[DISTANCES] = {};
+
+        histogram_t histograms[DISTANCES];
+
+        unsigned int next = 0;
+        unsigned int running_error[DISTANCES] = {};
+
+        #pragma omp parallel reduction(merge:histograms[:DISTANCES])
+        for (;;)
+        {
+            unsigned int chunk;
+            #pragma omp atomic capture
+            chunk = next++;
+            if (chunk >= 4096 / CHUNK)
+                break;
+
+            bool active[DISTANCES];
+            bool any = false;
+            for (unsigned int d = 0; d < DISTANCES; d++)
+            {
+                bool halt;
+                #pragma omp atomic read
+                halt = done[d];
+                active[d] = !halt;
+                any = any || active[d];
+            }
+            if (!any)
+                break;
+
+            unsigned int chunk_error[DISTANCES] = {};
+            for (unsigned int b = chunk * CHUNK; b < (chunk + 1) * CHUNK; b += Mixer::BATCH)
+            {
+                unsigned int index[Mixer::BATCH];
+                unsigned int gathered[Mixer::BATCH];
+                const unsigned int* osc = GetBatch(inputs, b, order, index, gathered);
+
+                for (unsigned int d = 0; d < DISTANCES; d++)
                 {
-                    #pragma omp ordered
-                    std::cout << std::hex << std::setfill('0')
-                              << std::setw(3) << j << " "
-                              << std::setw(3) << osc << " "
-                              << std::setw(2) << refval << " "
-                              << std::setw(2) << simval << " "
-                              << std::setw(2) << (simval ^ refval) << " "
-#if 0
-                              << getAnalogValue(bitarray) << " "
-#endif
-                              << std::endl;
+                    if (!active[d])
+                        continue;
+
+                    unsigned int simval[Mixer::BATCH];
+                    mixers[d].Score8(osc, threshold, simval);
+                    chunk_error[d] += AddBatch(simval, index, reference, histograms[d]);
                 }
+            }
+
+            for (unsigned int d = 0; d < DISTANCES; d++)
+            {
+                if (!active[d])
+                    continue;
 
-                // halt if we already are worst than the best score
-                if (score.audible_error > bestscore)
+                unsigned int running;
+                #pragma omp atomic capture
+                running = running_error[d] += chunk_error[d];
+
+                if (running > bestscore)
                 {
-                    done = true;
-                    #pragma omp flush(done)
-#ifndef _OPENMP
-                    return score;
-#endif
+                    #pragma omp atomic write
+                    done[d] = true;
                 }
             }
         }
-        score.rms = std::sqrt(sum/4096.0);
-        return score;
+
+        for (unsigned int d = 0; d < DISTANCES; d++)
+            scores[d] = histograms[d].GetScore();
     }
 };
 
@@ -0,0 +1,163 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <ostream>
+
+/**
+ * Philox4x32-10 counter based random number generator,
+ * from Salmon et al. "Parallel random numbers: as easy as 1, 2, 3".
+ *
+ * Each output block is a function of the 64 bit seed, the 64 bit stream
+ * and the 64 bit position in the stream only, so any number of generators
+ * with the same seed and different streams give independent sequences
+ * which can be created anywhere, in any order and on any thread,
+ * without sharing any state.
+ *
+ * It satisfies the UniformRandomBitGenerator requirements
+ * so it can be used with the standard distributions.
+ */
+class Philox
+{
+public:
+    typedef uint32_t result_type;
+
+private:
+    static constexpr uint32_t M0 = 0xD2511F53;
+    static constexpr uint32_t M1 = 0xCD9E8D57;
+    static constexpr uint32_t W0 = 0x9E3779B9;
+    static constexpr uint32_t W1 = 0xBB67AE85;
+
+    uint64_t seed;
+    uint64_t stream;
+
+    /// position of the next block in the stream
+    uint64_t block;
+
+    /// the current block and the index of its next value, 4 when used up
+    uint32_t output[4];
+    unsigned int index;
+
+private:
+    static void Round(uint32_t c[4], const uint32_t k[2])
+    {
+        const uint64_t p0 = static_cast<uint64_t>(M0) * c[0];
+        const uint64_t p1 = static_cast<uint64_t>(M1) * c[2];
+        const uint32_t c1 = c[1];
+        const uint32_t c3 = c[3];
+        c[0] = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k[0];
+        c[1] = static_cast<uint32_t>(p1);
+        c[2] = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k[1];
+        c[3] = static_cast<uint32_t>(p0);
+    }
+
+    void Generate(uint64_t position)
+    {
+        uint32_t c[4] =
+        {
+            static_cast<uint32_t>(position),
+            static_cast<uint32_t>(position >> 32),
+            static_cast<uint32_t>(stream),
+            static_cast<uint32_t>(stream >> 32)
+        };
+        uint32_t k[2] = { static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32) };
+
+        for (int r = 0; r < 10; r++)
+        {
+            if (r)
+            {
+                k[0] += W0;
+                k[1] += W1;
+            }
+            Round(c, k);
+        }
+
+        for (int i = 0; i < 4; i++)
+            output[i] = c[i];
+    }
+
+public:
+    /**
+     * @param seed the key shared by all the streams of a run
+     * @param stream the index of the sequence
+     */
+    explicit Philox(uint64_t seed = 0, uint64_t stream = 0) :
+        seed(seed),
+        stream(stream),
+        block(0),
+        index(4)
+    {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        if (index == 4)
+        {
+            Generate(block++);
+            index = 0;
+        }
+        return output[index++];
+    }
+
+    uint64_t GetSeed() const { return seed; }
+
+    friend std::ostream& operator<<(std::ostream &out, const Philox &p)
+    {
+        return out << p.seed << " " << p.stream << " " << p.block << " " << p.index;
+    }
+
+    friend std::istream& operator>>(std::istream &in, Philox &p)
+    {
+        Philox q;
+        if ((in >> q.seed >> q.stream >> q.block >> q.index) && (q.index <= 4) && ((q.index == 4) || q.block))
+        {
+            // regenerate the block being consumed
+            if (q.index < 4)
+                q.Generate(q.block - 1);
+            p = q;
+        }
+        else
+        {
+            in.setstate(std::ios_base::failbit);
+        }
+        return in;
+    }
+};
+
+/**
+ * Derive the seed of a separate run, e.g. a fit of a batch,
+ * from the seed of the whole session, with the SplitMix64 mixer.
+ */
+inline uint64_t DeriveSeed(uint64_t seed, uint64_t index)
+{
+    uint64_t z = seed + (index + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+
+/**
+ * Work stealing scheduler for long running independent jobs.
+ *
+ * Jobs are dealt round robin to a queue for each thread.
+ * Each thread takes jobs from the front of its own queue and,
+ * once it runs out of work, steals from the back of the others
+ * so that all the threads stay busy until the last job is started.
+ */
+class Scheduler
+{
+private:
+    struct queue_t
+    {
+        std::mutex lock;
+        std::deque<unsigned int> jobs;
+    };
+
+    std::vector<queue_t> queues;
+
+private:
+    bool PopFront(unsigned int self, unsigned int &job)
+    {
+        std::lock_guard<std::mutex> guard(queues[self].lock);
+        if (queues[self].jobs.empty())
+            return false;
+        job = queues[self].jobs.front();
+        queues[self].jobs.pop_front();
+        return true;
+    }
+
+    bool Steal(unsigned int self, unsigned int &job)
+    {
+        for (unsigned int i = 1; i < queues.size(); i++)
+        {
+            queue_t &victim = queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.jobs.empty())
+            {
+                job = victim.jobs.back();
+                victim.jobs.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    /**
+     * @param count the number of jobs, identified by their index
+     */
+    Scheduler(unsigned int count) :
+#ifdef _OPENMP
+        queues(omp_get_max_threads())
+#else
+        queues(1)
+#endif
+    {
+        for (unsigned int job = 0; job < count; job++)
+            queues[job % queues.size()].jobs.push_back(job);
+    }
+
+    /**
+     * Run all the jobs, returns when they are all completed.
+     *
+     * @param run the function called with the index of each job
+     */
+    template<typename F>
+    void Run(F run)
+    {
+        #pragma omp parallel num_threads(queues.size())
+        {
+#ifdef _OPENMP
+            const unsigned int self = omp_get_thread_num();
+#else
+            const unsigned int self = 0;
+#endif
+            unsigned int job;
+            while (PopFront(self, job) || Steal(self, job))
+                run(job);
+        }
+    }
+};
+
+#endif
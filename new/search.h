@@ -0,0 +1,651 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "parameters.h"
+#include "random.h"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+static const float EPSILON = 1e-4;
+
+/**
+ * Source of the random values used by the mutations.
+ *
+ * All the generators of a fit share its seed: the main one, used
+ * by the sequential searches, is stream 0 while the others are created
+ * on the fly with the number of the evaluation as stream, so concurrent
+ * candidates draw from independent sequences which are the same
+ * whatever the number of threads, and need no saving in the checkpoints.
+ */
+struct random_t
+{
+    Philox prng;
+
+    /// multiplier applied to the mutated parameters
+    std::normal_distribution<> normal_dist;
+
+    /// fresh value for parameters that became too small
+    std::normal_distribution<> normal_dist2;
+
+    /**
+     * @param stream the index of the sequence
+     * @param sigma the width of the mutations
+     */
+    random_t(uint64_t seed, uint64_t stream = 0, double sigma = 0.005) :
+        prng(seed, stream),
+        normal_dist(1.0, sigma),
+        normal_dist2(0.5, 0.2)
+    {}
+
+    double GetRandomValue()
+    {
+        return normal_dist(prng);
+    }
+
+    float GetNewRandomValue()
+    {
+        return static_cast<float>(normal_dist2(prng));
+    }
+
+    /**
+     * Serialize the state of the generators.
+     */
+    std::string GetState() const
+    {
+        std::ostringstream ss;
+        ss << prng << " " << normal_dist << " " << normal_dist2;
+        return ss.str();
+    }
+
+    /**
+     * Restore the state of the generators.
+     *
+     * @return false if the state is invalid
+     */
+    bool SetState(const std::string &state)
+    {
+        std::istringstream ss(state);
+        ss >> prng >> normal_dist >> normal_dist2;
+        return !ss.fail();
+    }
+};
+
+/**
+ * Randomly alter the parameters of p starting from the base values,
+ * loop until at least one parameter has changed.
+ *
+ * @return bit mask of the changed parameters, indexed by Param_t
+ */
+inline unsigned int Mutate(Parameters &p, const Parameters &base, int wave, random_t &random)
+{
+    unsigned int mutated = 0;
+    bool changed = false;
+    while (!changed)
+    {
+        for (Param_t i = Param_t::THRESHOLD; i <= Param_t::DISTANCE2; i++)
+        {
+            // PULSESTRENGTH only affects pulse
+            if ((i==Param_t::PULSESTRENGTH) && ((wave & 0x04) != 0x04))
+            {
+                continue;
+            }
+
+            // TOPBIT only affects saw
+            if ((i==Param_t::TOPBIT) && ((wave & 0x02) != 0x02))
+            {
+                continue;
+            }
+
+            // change a parameter with 50% proability
+            if (random.GetRandomValue() > 1.)
+            {
+                const float oldValue = base.GetValue(i);
+
+                //std::cout << newValue << " -> ";
+                float newValue = static_cast<float>(random.GetRandomValue()*oldValue);
+                //float newValue = oldValue + GetRandomValue();
+                //std::cout << newValue << std::endl;
+
+                // avoid negative values
+                if (newValue <= 0.f)
+                {
+                    newValue = EPSILON;
+                }
+                // try to avoid too small values
+                else if (newValue < EPSILON)
+                    newValue += random.GetNewRandomValue();
+
+                // check for parameters limits
+                //if (((i == Param_t::THRESHOLD) || (i == Param_t::PULSESTRENGTH))
+                //    && (newValue >= 1.f))
+                //{
+                //    newValue = 1.f - EPSILON;
+                //}
+
+                p.SetValue(i, newValue);
+                if (oldValue != newValue)
+                    mutated |= 1 << static_cast<unsigned int>(i);
+                changed = changed || oldValue != newValue;
+            }
+        }
+    }
+    return mutated;
+}
+
+/**
+ * Ask and tell interface of the search strategies.
+ *
+ * The optimizer asks for a batch of candidates, scores them
+ * concurrently, each one stopping early at its own bound, and then
+ * tells the scores back. The search keeps a set of members, the best
+ * of which the optimizer compares with its incumbent.
+ */
+class Search
+{
+public:
+    virtual ~Search() = default;
+
+    /**
+     * Get the candidates to be scored,
+     * the scoring may switch their distance function.
+     */
+    virtual std::vector<Parameters>& Ask() = 0;
+
+    /**
+     * Get the bound for the early exit of the n-th candidate.
+     */
+    virtual unsigned int Bound(unsigned int n) const = 0;
+
+    /**
+     * Get the mask of the parameters changed in the n-th candidate, indexed by Param_t.
+     */
+    virtual unsigned int Mutated(unsigned int n) const = 0;
+
+    /**
+     * Get the cache of the mixes the n-th candidate is scored with, if any.
+     */
+    virtual mix_cache_t* Cache(unsigned int) { return nullptr; }
+
+    /**
+     * Update the members with the scores of the candidates.
+     */
+    virtual void Tell(const std::vector<score_t> &scores) = 0;
+
+    /**
+     * Get the index of the best member.
+     */
+    virtual unsigned int Best() const = 0;
+
+    virtual const Parameters& Member(unsigned int n) const = 0;
+    virtual const score_t& MemberScore(unsigned int n) const = 0;
+};
+
+/**
+ * Monte Carlo random walk from a single base.
+ *
+ * A single candidate at a time is mutated from the base with the main
+ * generator, keeping the values it's not mutated in, so the rows of
+ * the previous candidates are re-used when its distances are left alone.
+ * With a population each step mutates that many fresh copies of the base,
+ * each from its own stream, scored against a cache filled from the base.
+ * The best candidate becomes the base if it is not worse, a tie
+ * increases the "entropy" of the walk.
+ */
+class MonteCarlo : public Search
+{
+private:
+    const int wave;
+
+    random_t &rng;
+
+    /// use the cache of the mixes, not with the search of the distance function
+    const bool cached;
+
+    Parameters base;
+    score_t score;
+
+    std::vector<Parameters> candidates;
+    std::vector<unsigned int> mutated;
+    mix_cache_t cache;
+
+    /// number of the next evaluation, the stream of its candidate
+    uint64_t next;
+
+public:
+    /**
+     * @param current the candidate the sequential walk continues from
+     * @param size the number of candidates evaluated concurrently, one for the sequential walk
+     * @param rng the main generator, whose seed is shared by the streams of the population
+     * @param next the number of the next evaluation
+     */
+    MonteCarlo(const Parameters &base, const score_t &score, const Parameters &current, int wave,
+               unsigned int size, random_t &rng, uint64_t next, bool cached) :
+        wave(wave),
+        rng(rng),
+        cached(cached),
+        base(base),
+        score(score),
+        candidates(size < 1 ? 1 : size, current),
+        mutated(candidates.size(), 0),
+        next(next)
+    {}
+
+    std::vector<Parameters>& Ask() override
+    {
+        if (candidates.size() == 1)
+        {
+            mutated[0] = Mutate(candidates[0], base, wave, rng);
+            if (cached)
+                candidates[0].ResetCache(wave, cache);
+            return candidates;
+        }
+
+        if (cached)
+            base.FillCache(wave, cache);
+
+        for (unsigned int n = 0; n < candidates.size(); n++)
+        {
+            random_t random(rng.prng.GetSeed(), next + n);
+            candidates[n] = base;
+            mutated[n] = Mutate(candidates[n], base, wave, random);
+        }
+        return candidates;
+    }
+
+    unsigned int Bound(unsigned int) const override { return score.audible_error; }
+
+    unsigned int Mutated(unsigned int n) const override { return mutated[n]; }
+
+    mix_cache_t* Cache(unsigned int) override { return cached ? &cache : nullptr; }
+
+    void Tell(const std::vector<score_t> &scores) override
+    {
+        unsigned int best = 0;
+        for (unsigned int n = 1; n < candidates.size(); n++)
+        {
+            if (scores[best].isBetter(scores[n]))
+                best = n;
+        }
+
+        if (score.isBetter(scores[best]))
+        {
+            base = candidates[best];
+            score = scores[best];
+        }
+        else if (scores[best].audible_error == score.audible_error)
+        {
+            // no improvement but use new parameters as base to increase the "entropy"
+            base = candidates[best];
+        }
+        next += candidates.size();
+    }
+
+    unsigned int Best() const override { return 0; }
+
+    const Parameters& Member(unsigned int) const override { return base; }
+    const score_t& MemberScore(unsigned int) const override { return score; }
+
+    /**
+     * Get the candidate the sequential walk continues from.
+     */
+    const Parameters& Current() const { return candidates[0]; }
+};
+
+/**
+ * Independent Monte Carlo chains, each with its own mutation width,
+ * stepping together. After a number of steps the best states
+ * move towards the narrowest chains, which refine them, while
+ * the wider ones keep exploring, and the chains stuck on a plateau
+ * restart from the best state found by all of them.
+ * Each step asks for a candidate per chain, drawn from the stream
+ * given by its chain and the number of the step.
+ */
+class Chains : public Search
+{
+private:
+    /// mutation width of the narrowest chain, doubled for each following one
+    static constexpr double SIGMA = 0.005;
+
+    /// steps of each chain between two exchanges
+    static constexpr unsigned int STEPS = 100;
+
+    /// exchanges without improvement after which a chain restarts from the best parameters
+    static constexpr unsigned int RESTART = 50;
+
+    struct chain_t
+    {
+        double sigma;
+        Parameters base;
+        score_t score;
+        unsigned int stale;
+        mix_cache_t cache;
+    };
+
+    const int wave;
+
+    const uint64_t seed;
+
+    /// use the cache of the mixes, not with the search of the distance function
+    const bool cached;
+
+    std::vector<chain_t> chains;
+
+    /// the current state of each chain
+    std::vector<Parameters> candidates;
+    std::vector<unsigned int> mutated;
+
+    /// the best state of all the chains, the restarts start from it
+    Parameters incumbent;
+    score_t incumbentScore;
+
+    /// number of the first evaluation of the current exchange
+    uint64_t first;
+
+    unsigned int step;
+
+public:
+    /**
+     * @param count the number of chains, at least two
+     * @param first the number of the next evaluation
+     */
+    Chains(const Parameters &initial, const score_t &score, int wave, unsigned int count,
+           uint64_t seed, uint64_t first, bool cached) :
+        wave(wave),
+        seed(seed),
+        cached(cached),
+        candidates(count < 2 ? 2 : count, initial),
+        mutated(candidates.size(), 0),
+        incumbent(initial),
+        incumbentScore(score),
+        first(first),
+        step(0)
+    {
+        double sigma = SIGMA;
+        for (unsigned int k = 0; k < candidates.size(); k++, sigma *= 2.)
+        {
+            chains.push_back({ sigma, initial, score, 0, mix_cache_t() });
+        }
+    }
+
+    std::vector<Parameters>& Ask() override
+    {
+        for (unsigned int k = 0; k < chains.size(); k++)
+        {
+            chain_t &c = chains[k];
+            if (step == 0)
+                c.stale++;
+
+            random_t random(seed, first + k * STEPS + step, c.sigma);
+            mutated[k] = Mutate(candidates[k], c.base, wave, random);
+            if (cached)
+                candidates[k].ResetCache(wave, c.cache);
+        }
+        return candidates;
+    }
+
+    unsigned int Bound(unsigned int n) const override { return chains[n].score.audible_error; }
+
+    unsigned int Mutated(unsigned int n) const override { return mutated[n]; }
+
+    mix_cache_t* Cache(unsigned int n) override { return cached ? &chains[n].cache : nullptr; }
+
+    void Tell(const std::vector<score_t> &scores) override
+    {
+        for (unsigned int k = 0; k < chains.size(); k++)
+        {
+            chain_t &c = chains[k];
+            if (c.score.isBetter(scores[k]))
+            {
+                c.base = candidates[k];
+                c.score = scores[k];
+                c.stale = 0;
+            }
+            else if (scores[k].audible_error == c.score.audible_error)
+            {
+                c.base = candidates[k];
+            }
+        }
+
+        if (++step < STEPS)
+            return;
+
+        step = 0;
+        first += chains.size() * STEPS;
+
+        const unsigned int best = Best();
+        if (incumbentScore.isBetter(chains[best].score))
+        {
+            incumbent = chains[best].base;
+            incumbentScore = chains[best].score;
+        }
+        else if (chains[best].score.audible_error == incumbentScore.audible_error)
+        {
+            incumbent = chains[best].base;
+        }
+
+        // exchange the states of adjacent chains when the wider one has found a better one
+        for (unsigned int k = chains.size() - 1; k > 0; k--)
+        {
+            chain_t &narrow = chains[k - 1];
+            chain_t &wide = chains[k];
+            if (narrow.score.isBetter(wide.score))
+            {
+                std::swap(narrow.base, wide.base);
+                std::swap(candidates[k - 1], candidates[k]);
+                std::swap(narrow.score, wide.score);
+                narrow.stale = 0;
+            }
+        }
+
+        for (unsigned int k = 0; k < chains.size(); k++)
+        {
+            chain_t &c = chains[k];
+            if (c.stale >= RESTART)
+            {
+                c.base = candidates[k] = incumbent;
+                c.score = incumbentScore;
+                c.stale = 0;
+            }
+        }
+    }
+
+    unsigned int Best() const override
+    {
+        unsigned int best = 0;
+        for (unsigned int k = 1; k < chains.size(); k++)
+        {
+            if (chains[best].score.isBetter(chains[k].score))
+                best = k;
+        }
+        return best;
+    }
+
+    const Parameters& Member(unsigned int n) const override { return chains[n].base; }
+    const score_t& MemberScore(unsigned int n) const override { return chains[n].score; }
+};
+
+/**
+ * Differential evolution, DE/rand/1/bin.
+ *
+ * Each member of the population is challenged by a trial vector obtained
+ * adding the scaled difference of two random members to a third one,
+ * crossed over with the member, and replaced if the trial is not worse.
+ * The parameters are all positive with very different scales so the
+ * search is done on their logarithm.
+ * The first generation scores the population, spread around the initial parameters.
+ */
+template<typename PRNG>
+class DifferentialEvolution : public Search
+{
+private:
+    /// differential weight
+    static constexpr double F = 0.7;
+
+    /// crossover probability
+    static constexpr double CR = 0.9;
+
+    /// spread of the initial population
+    static constexpr double SPREAD = 0.05;
+
+    PRNG &prng;
+
+    std::vector<Param_t> dims;
+
+    std::vector<Parameters> population;
+    std::vector<score_t> scores;
+
+    std::vector<Parameters> trials;
+    std::vector<unsigned int> mutated;
+
+    bool initialized;
+
+private:
+    unsigned int Pick(unsigned int size, unsigned int exclude1, unsigned int exclude2, unsigned int exclude3)
+    {
+        std::uniform_int_distribution<unsigned int> dist(0, size - 1);
+        unsigned int r;
+        do
+        {
+            r = dist(prng);
+        }
+        while ((r == exclude1) || (r == exclude2) || (r == exclude3));
+        return r;
+    }
+
+public:
+    /**
+     * @param initial the parameters around which the population is spread
+     * @param wave the waveform, only the parameters affecting it are searched
+     * @param size the size of the population, at least four
+     */
+    DifferentialEvolution(const Parameters &initial, int wave, unsigned int size, PRNG &prng) :
+        prng(prng),
+        population(size < 4 ? 4 : size, initial),
+        scores(population.size()),
+        trials(population.size()),
+        mutated(population.size(), 0),
+        initialized(false)
+    {
+        for (Param_t i = Param_t::THRESHOLD; i <= Param_t::DISTANCE2; i++)
+        {
+            // PULSESTRENGTH only affects pulse, TOPBIT only affects saw
+            if ((i == Param_t::PULSESTRENGTH) && ((wave & 0x04) != 0x04))
+                continue;
+            if ((i == Param_t::TOPBIT) && ((wave & 0x02) != 0x02))
+                continue;
+            dims.push_back(i);
+        }
+
+        std::normal_distribution<> dist(0., SPREAD);
+        for (unsigned int n = 1; n < population.size(); n++)
+        {
+            for (Param_t i: dims)
+            {
+                population[n].SetValue(i, static_cast<float>(initial.GetValue(i) * std::exp(dist(prng))));
+                mutated[n] |= 1 << static_cast<unsigned int>(i);
+            }
+        }
+    }
+
+    std::vector<Parameters>& Ask() override
+    {
+        if (!initialized)
+            return population;
+
+        std::uniform_real_distribution<> uniform(0., 1.);
+        std::uniform_int_distribution<unsigned int> dim(0, dims.size() - 1);
+
+        const unsigned int size = population.size();
+        for (unsigned int n = 0; n < size; n++)
+        {
+            const unsigned int a = Pick(size, n, n, n);
+            const unsigned int b = Pick(size, n, a, a);
+            const unsigned int c = Pick(size, n, a, b);
+
+            trials[n] = population[n];
+            mutated[n] = 0;
+            const unsigned int forced = dim(prng);
+            for (unsigned int d = 0; d < dims.size(); d++)
+            {
+                if ((d != forced) && (uniform(prng) >= CR))
+                    continue;
+
+                const Param_t i = dims[d];
+                const double value = std::log(population[a].GetValue(i))
+                    + F * (std::log(population[b].GetValue(i)) - std::log(population[c].GetValue(i)));
+                trials[n].SetValue(i, static_cast<float>(std::exp(value)));
+                mutated[n] |= 1 << static_cast<unsigned int>(i);
+            }
+        }
+        return trials;
+    }
+
+    unsigned int Bound(unsigned int n) const override
+    {
+        // the trial is only useful if it is not worse than its target
+        return initialized ? scores[n].audible_error : 4096 * 255;
+    }
+
+    unsigned int Mutated(unsigned int n) const override { return mutated[n]; }
+
+    void Tell(const std::vector<score_t> &newScores) override
+    {
+        if (!initialized)
+        {
+            scores = newScores;
+            initialized = true;
+            return;
+        }
+
+        for (unsigned int n = 0; n < population.size(); n++)
+        {
+            if (!newScores[n].isBetter(scores[n]))
+            {
+                population[n] = trials[n];
+                scores[n] = newScores[n];
+            }
+        }
+    }
+
+    unsigned int Best() const override
+    {
+        unsigned int best = 0;
+        for (unsigned int n = 1; n < population.size(); n++)
+        {
+            if (scores[best].isBetter(scores[n]))
+                best = n;
+        }
+        return best;
+    }
+
+    const Parameters& Member(unsigned int n) const override { return population[n]; }
+    const score_t& MemberScore(unsigned int n) const override { return scores[n]; }
+};
+
+#endif
@@ -0,0 +1,154 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "parameters.h"
+
+#include <ostream>
+
+/**
+ * Throughput and acceptance statistics of a fit.
+ */
+struct fit_stats_t
+{
+    struct param_stats_t
+    {
+        /// candidates where the parameter was mutated
+        unsigned long tried;
+
+        /// of which better than the incumbent
+        unsigned long improved;
+
+        /// of which with the same audible error of the incumbent
+        unsigned long ties;
+    };
+
+    /// time since the start of the fit
+    double seconds;
+
+    /// time since the last improvement
+    double sinceImprovement;
+
+    unsigned long evaluations;
+
+    /// total number of values scored, to measure the effect of the early exit
+    unsigned long long samples;
+
+    unsigned long improved;
+    unsigned long ties;
+
+    param_stats_t param[PARAMS];
+
+    /// the incumbent
+    score_t best;
+
+    fit_stats_t() :
+        seconds(0.),
+        sinceImprovement(0.),
+        evaluations(0),
+        samples(0),
+        improved(0),
+        ties(0),
+        param()
+    {}
+
+    /**
+     * Account for an evaluated candidate.
+     *
+     * @param mutated bit mask of the mutated parameters, indexed by Param_t
+     * @param score the score of the candidate
+     * @param incumbent the score of the best parameters when the candidate was evaluated
+     */
+    void Add(unsigned int mutated, const score_t &score, const score_t &incumbent)
+    {
+        const bool better = incumbent.isBetter(score);
+        const bool tie = !better && (score.audible_error == incumbent.audible_error);
+
+        evaluations++;
+        samples += score.samples;
+        improved += better;
+        ties += tie;
+        for (unsigned int i = 0; i < PARAMS; i++)
+        {
+            if (mutated & (1 << i))
+            {
+                param[i].tried++;
+                param[i].improved += better;
+                param[i].ties += tie;
+            }
+        }
+    }
+
+    /**
+     * Add the counters of the statistics collected elsewhere,
+     * such as another chain of the same fit.
+     */
+    void Merge(const fit_stats_t &other)
+    {
+        evaluations += other.evaluations;
+        samples += other.samples;
+        improved += other.improved;
+        ties += other.ties;
+        for (unsigned int i = 0; i < PARAMS; i++)
+        {
+            param[i].tried += other.param[i].tried;
+            param[i].improved += other.param[i].improved;
+            param[i].ties += other.param[i].ties;
+        }
+    }
+};
+
+/**
+ * Write the statistics as a single line JSON object.
+ *
+ * @param previous the statistics of the previous report, to compute the current rate
+ */
+inline void WriteStatsJson(const fit_stats_t &stats, const fit_stats_t &previous,
+                           const char* chip, int wave, std::ostream &out)
+{
+    const double interval = stats.seconds - previous.seconds;
+    const unsigned long evaluations = stats.evaluations - previous.evaluations;
+
+    out << "{\"chip\":\"" << chip << "\",\"wave\":" << wave
+        << ",\"seconds\":" << stats.seconds
+        << ",\"evaluations\":" << stats.evaluations
+        << ",\"evaluations_per_second\":" << (interval > 0. ? evaluations / interval : 0.)
+        << ",\"average_samples\":"
+        << (evaluations ? static_cast<double>(stats.samples - previous.samples) / evaluations : 0.)
+        << ",\"audible_error\":" << stats.best.audible_error
+        << ",\"wrong_bits\":" << stats.best.wrong_bits
+        << ",\"since_improvement\":" << stats.sinceImprovement
+        << ",\"improved\":" << stats.improved
+        << ",\"ties\":" << stats.ties
+        << ",\"params\":{";
+    for (Param_t i = Param_t::THRESHOLD; i <= Param_t::DISTANCE2; i++)
+    {
+        const fit_stats_t::param_stats_t &p = stats.param[static_cast<unsigned int>(i)];
+        out << (i == Param_t::THRESHOLD ? "" : ",")
+            << "\"" << GetParamName(i) << "\":{\"tried\":" << p.tried
+            << ",\"improved\":" << p.improved
+            << ",\"ties\":" << p.ties << "}";
+    }
+    out << "}}" << std::endl;
+}
+
+#endif
@@ -0,0 +1,254 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef STORE_H
+#define STORE_H
+
+#include "parameters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Best known parameters for each chip and waveform.
+ *
+ * The store is a text file with one line per chip and waveform:
+ *
+ *     <chip> <wave> <6581|8580> <distance> <threshold> <pulsestrength> <topbit> <distance1> <distance2> <audible_error> <wrong_bits> <rms>
+ *
+ * Empty lines and lines starting with # are ignored.
+ * The file is loaded once in a hash map and rewritten
+ * when better parameters are found.
+ */
+class ParamStore
+{
+public:
+    static constexpr const char* DEFAULT_FILE = "params.txt";
+
+    struct entry_t
+    {
+        std::string chip;
+        int wave;
+        bool is8580;
+        Parameters params;
+        score_t score;
+
+        /// position in the file, to keep the order when saving
+        unsigned int order;
+    };
+
+private:
+    std::unordered_map<std::string, entry_t> entries;
+
+    std::string fileName;
+
+    mutable std::mutex lock;
+
+    bool dirty;
+
+    std::chrono::steady_clock::time_point lastSave;
+
+private:
+    static std::string Key(const std::string &chip, int wave)
+    {
+        return chip + ":" + std::to_string(wave);
+    }
+
+    bool Write()
+    {
+        std::vector<const entry_t*> sorted;
+        for (const auto &e: entries)
+            sorted.push_back(&e.second);
+        std::sort(sorted.begin(), sorted.end(),
+            [](const entry_t* a, const entry_t* b) { return a->order < b->order; });
+
+        // write to a temporary file so an interrupted run never leaves a partial store
+        const std::string tmp = fileName + ".tmp";
+        {
+            std::ofstream ofs(tmp.c_str());
+            if (!ofs.is_open())
+            {
+                std::cout << "Error opening file " << tmp << std::endl;
+                return false;
+            }
+
+            ofs << "# Best known parameters for each chip and waveform." << std::endl
+                << "# The score is the acoustic error followed by the number" << std::endl
+                << "# of mispredicted bits, on a total of 32768, and the RMS." << std::endl
+                << "#" << std::endl
+                << "# chip wave model distance threshold pulsestrength topbit distance1 distance2 audible_error wrong_bits rms" << std::endl;
+
+            for (const entry_t* e: sorted)
+            {
+                const Parameters &p = e->params;
+                ofs.precision(flt::max_digits10);
+                ofs << e->chip << " " << e->wave << " " << (e->is8580 ? "8580" : "6581") << " "
+                    << GetDistanceName(p.distFunc) << " "
+                    << p.threshold << " " << p.pulsestrength << " " << p.topbit << " "
+                    << p.distance1 << " " << p.distance2 << " ";
+                ofs.precision(2);
+                ofs << e->score.audible_error << " " << e->score.wrong_bits << " "
+                    << std::fixed << e->score.rms << std::endl;
+                ofs.unsetf(std::ios_base::floatfield);
+            }
+            if (!ofs)
+                return false;
+        }
+        return std::rename(tmp.c_str(), fileName.c_str()) == 0;
+    }
+
+public:
+    ParamStore() :
+        dirty(false)
+    {}
+
+    /**
+     * Load the store from file.
+     *
+     * @return false on error, which is reported on stdout
+     */
+    bool Load(const char* file = DEFAULT_FILE)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        fileName = file;
+        entries.clear();
+
+        std::ifstream ifs(file);
+        if (!ifs.is_open())
+        {
+            std::cout << "Error opening file " << file << std::endl;
+            return false;
+        }
+
+        std::string line;
+        unsigned int lineNo = 0;
+        while (std::getline(ifs, line))
+        {
+            lineNo++;
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            std::istringstream ss(line);
+            entry_t e;
+            std::string model;
+            std::string distance;
+            ss >> e.chip >> e.wave >> model >> distance
+               >> e.params.threshold >> e.params.pulsestrength >> e.params.topbit
+               >> e.params.distance1 >> e.params.distance2
+               >> e.score.audible_error >> e.score.wrong_bits >> e.score.rms;
+            if (!ss || !ParseDistanceName(distance.c_str(), e.params.distFunc)
+                || (model != "6581" && model != "8580"))
+            {
+                std::cout << "Error parsing " << file << " at line " << lineNo << std::endl;
+                return false;
+            }
+            e.is8580 = model == "8580";
+            e.order = entries.size();
+            entries[Key(e.chip, e.wave)] = e;
+        }
+
+        lastSave = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    /**
+     * Get the stored parameters for the chip and waveform.
+     *
+     * @return false if not found
+     */
+    bool Get(const std::string &chip, int wave, entry_t &entry) const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        const auto it = entries.find(Key(chip, wave));
+        if (it == entries.end())
+            return false;
+        entry = it->second;
+        return true;
+    }
+
+    /**
+     * Store the parameters if they are better than the current ones.
+     *
+     * @return true if the store was updated
+     */
+    bool Update(const std::string &chip, int wave, bool is8580, const Parameters &params, const score_t &score)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        const std::string key = Key(chip, wave);
+        auto it = entries.find(key);
+        if (it == entries.end())
+        {
+            entry_t e;
+            e.chip = chip;
+            e.wave = wave;
+            e.order = entries.size();
+            it = entries.emplace(key, e).first;
+        }
+        else if (!it->second.score.isBetter(score))
+        {
+            return false;
+        }
+
+        it->second.is8580 = is8580;
+        it->second.params = params;
+        it->second.score = score;
+        dirty = true;
+        return true;
+    }
+
+    /**
+     * Write the store back to file if it was updated.
+     *
+     * @param force if false the file is written at most once per second
+     * @return false on error
+     */
+    bool Save(bool force = true)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        if (!dirty || fileName.empty())
+            return true;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (!force && (now - lastSave < std::chrono::seconds(1)))
+            return true;
+
+        // keep the update pending if the write fails, so the next save retries it
+        if (!Write())
+            return false;
+
+        dirty = false;
+        lastSave = now;
+        return true;
+    }
+};
+
+#endif
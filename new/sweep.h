@@ -0,0 +1,213 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "parameters.h"
+#include "offload.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <utility>
+#include <vector>
+
+/**
+ * Coarse to fine sweep of the error landscape over two parameters,
+ * the others being fixed.
+ *
+ * The first level is a size x size grid, evenly spaced in log scale
+ * from start/range to start*range for each parameter.
+ * Each following level is a grid of the same size with half the spacing
+ * centered on the best point so far, so it includes some of the points
+ * already scored: all the points lie on the lattice of the finest level
+ * and the scores are kept by lattice position, so they are never
+ * computed twice. Each level is scored at once with the batch scorer.
+ */
+class GridSweep
+{
+public:
+    static constexpr unsigned int MIN_SIZE = 3;
+    static constexpr unsigned int MAX_SIZE = 257;
+    static constexpr unsigned int MAX_LEVELS = 16;
+
+    struct point_t
+    {
+        unsigned int level;
+        float x;
+        float y;
+        score_t score;
+    };
+
+private:
+    typedef std::pair<long, long> position_t;
+
+    const Param_t px;
+    const Param_t py;
+    const unsigned int size;
+    const unsigned int levels;
+    const double range;
+
+    std::map<position_t, score_t> scored;
+
+    /// the scored points in evaluation order
+    std::vector<point_t> points;
+
+private:
+    static float Centre(float v) { return v > 0.f ? v : 1.f; }
+
+public:
+    /**
+     * @param size points per side of each grid, made odd if needed
+     * @param levels number of refinements, including the first grid
+     * @param range ratio between the start value and the ends of the first grid
+     */
+    GridSweep(Param_t x, Param_t y, unsigned int size, unsigned int levels, double range) :
+        px(x),
+        py(y),
+        size(size | 1),
+        levels(levels ? levels : 1),
+        range(range)
+    {}
+
+    /**
+     * Run the sweep for the given chip and waveform.
+     *
+     * @param start the parameters whose values are swept around
+     * @param best the best scored point
+     * @return the parameters of the best point
+     */
+    Parameters Run(const BatchScorer &scorer, unsigned int chip, int wave, const Parameters &start, score_t &best)
+    {
+        const float cx = Centre(start.GetValue(px));
+        const float cy = Centre(start.GetValue(py));
+
+        // the log of the spacing of the finest level
+        const long half = (size - 1) / 2;
+        const double step = std::log(range) / half / (1L << (levels - 1));
+
+        auto value = [step](float centre, long position)
+        {
+            return static_cast<float>(centre * std::exp(position * step));
+        };
+
+        position_t centre(0, 0);
+        for (unsigned int level = 0; level < levels; level++)
+        {
+            const long stride = 1L << (levels - 1 - level);
+
+            std::vector<position_t> positions;
+            std::vector<Parameters> candidates;
+            for (long i = -half; i <= half; i++)
+            {
+                for (long j = -half; j <= half; j++)
+                {
+                    const position_t pos(centre.first + i * stride, centre.second + j * stride);
+                    if (scored.count(pos))
+                        continue;
+
+                    Parameters p = start;
+                    p.SetValue(px, value(cx, pos.first));
+                    p.SetValue(py, value(cy, pos.second));
+                    positions.push_back(pos);
+                    candidates.push_back(p);
+                }
+            }
+
+            // refine around the best point, keeping the earliest one in case of ties
+            const std::vector<score_t> scores = scorer.Score(candidates, chip, wave);
+            for (unsigned int n = 0; n < candidates.size(); n++)
+            {
+                if (points.empty() || best.isBetter(scores[n]))
+                {
+                    best = scores[n];
+                    centre = positions[n];
+                }
+                scored[positions[n]] = scores[n];
+                points.push_back({ level, candidates[n].GetValue(px), candidates[n].GetValue(py), scores[n] });
+            }
+        }
+
+        Parameters result = start;
+        result.SetValue(px, value(cx, centre.first));
+        result.SetValue(py, value(cy, centre.second));
+        return result;
+    }
+
+    const std::vector<point_t>& Points() const { return points; }
+
+    /**
+     * Write the landscape, as binary if the file name ends in .bin
+     * or CSV otherwise.
+     *
+     * The CSV has a header with the names of the swept parameters
+     * and a row for each scored point.
+     * The binary format is the magic "CWS1", the number of points
+     * and then for each point the level, the two values, the audible error,
+     * the wrong bits and the RMS, all 32 bit in host byte order.
+     *
+     * @return false on error
+     */
+    bool Write(const char* file) const
+    {
+        const char* ext = strrchr(file, '.');
+        const bool binary = ext && (strcmp(ext, ".bin") == 0);
+
+        std::ofstream ofs(file, binary ? std::ofstream::binary : std::ofstream::out);
+        if (!ofs.is_open())
+            return false;
+
+        if (binary)
+        {
+            const uint32_t count = points.size();
+            ofs.write("CWS1", 4);
+            ofs.write(reinterpret_cast<const char*>(&count), sizeof(count));
+            for (const point_t &p: points)
+            {
+                const uint32_t level = p.level;
+                const uint32_t audible_error = p.score.audible_error;
+                const uint32_t wrong_bits = p.score.wrong_bits;
+                const float rms = p.score.rms;
+                ofs.write(reinterpret_cast<const char*>(&level), sizeof(level));
+                ofs.write(reinterpret_cast<const char*>(&p.x), sizeof(p.x));
+                ofs.write(reinterpret_cast<const char*>(&p.y), sizeof(p.y));
+                ofs.write(reinterpret_cast<const char*>(&audible_error), sizeof(audible_error));
+                ofs.write(reinterpret_cast<const char*>(&wrong_bits), sizeof(wrong_bits));
+                ofs.write(reinterpret_cast<const char*>(&rms), sizeof(rms));
+            }
+        }
+        else
+        {
+            ofs.precision(flt::max_digits10);
+            ofs << "level," << GetParamName(px) << "," << GetParamName(py) << ",audible_error,wrong_bits,rms\n";
+            for (const point_t &p: points)
+            {
+                ofs << p.level << "," << p.x << "," << p.y << ","
+                    << p.score.audible_error << "," << p.score.wrong_bits << "," << p.score.rms << "\n";
+            }
+        }
+        return static_cast<bool>(ofs);
+    }
+};
+
+#endif
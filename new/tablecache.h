@@ -0,0 +1,321 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef TABLECACHE_H
+#define TABLECACHE_H
+
+#include "parameters.h"
+#include "tables.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+/**
+ * Combined waveform tables generated on first use and kept on disk.
+ *
+ * Each table is stored in its own file in the cache directory,
+ * named after a hash of the key, which is made of the model parameters,
+ * the waveform, the kind of table and the scoring engine:
+ *
+ *     char     magic[4]    "CWC1"
+ *     key_t    key
+ *     uint8_t  table[4096] or uint16_t table[4096] in host byte order
+ *
+ * A table is generated the first time it's requested, written to a
+ * temporary file and then renamed so concurrent players never see a partial
+ * one. Later requests, also from other processes, map the file in memory.
+ * If the directory is not writable the tables are kept in memory only.
+ *
+ * The returned tables stay valid for the lifetime of the cache.
+ * All the methods are thread safe.
+ */
+class TableCache
+{
+public:
+    /// change whenever the model changes, to ignore the tables generated by older versions
+    static constexpr uint32_t MODEL_VERSION = 1;
+
+private:
+    static constexpr const char MAGIC[4] = { 'C', 'W', 'C', '1' };
+
+    enum class kind_t : uint8_t
+    {
+        DIGITAL,
+        ANALOG
+    };
+
+    /// everything the table depends on, with the values as bit patterns
+    struct key_t
+    {
+        uint32_t version;
+        uint8_t kind;
+        uint8_t wave;
+        uint8_t distFunc;
+        uint8_t engine;
+        uint32_t values[PARAMS];
+    };
+
+    struct entry_t
+    {
+        const uint8_t* data;
+        size_t length;
+
+        /// the table when it's not mapped
+        std::vector<uint8_t> buffer;
+
+        entry_t() :
+            data(nullptr),
+            length(0)
+        {}
+
+        ~entry_t()
+        {
+#ifndef _WIN32
+            if (buffer.empty() && data)
+                munmap(const_cast<uint8_t*>(data), length);
+#endif
+        }
+
+        entry_t(const entry_t&) = delete;
+        entry_t& operator=(const entry_t&) = delete;
+
+        const void* Table() const { return data + sizeof(MAGIC) + sizeof(key_t); }
+    };
+
+    const std::string directory;
+
+    std::unordered_map<std::string, std::unique_ptr<entry_t>> entries;
+
+    std::mutex lock;
+
+private:
+    static key_t GetKey(const Parameters &p, int wave, kind_t kind)
+    {
+        key_t key;
+        memset(&key, 0, sizeof(key));
+        key.version = MODEL_VERSION;
+        key.kind = static_cast<uint8_t>(kind);
+        key.wave = wave;
+        key.distFunc = static_cast<uint8_t>(p.distFunc);
+        // the analog tables always use the floating point model
+        key.engine = (kind == kind_t::ANALOG) ? 0 : static_cast<uint8_t>(Parameters::GetEngine());
+        for (Param_t i = Param_t::THRESHOLD; i <= Param_t::DISTANCE2; i++)
+        {
+            const float v = p.GetValue(i);
+            memcpy(&key.values[static_cast<unsigned int>(i)], &v, sizeof(v));
+        }
+        return key;
+    }
+
+    /**
+     * Get the name of the file, the FNV-1a hash of the key.
+     */
+    static std::string GetName(const key_t &key)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&key);
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (unsigned int i = 0; i < sizeof(key); i++)
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ULL;
+        }
+
+        char name[21];
+        snprintf(name, sizeof(name), "%016llx.cwc", static_cast<unsigned long long>(hash));
+        return name;
+    }
+
+    /**
+     * Map the file, if it holds the table of the key.
+     */
+    static bool Load(const std::string &file, const key_t &key, size_t length, entry_t &entry)
+    {
+#ifndef _WIN32
+        const int fd = open(file.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != length)
+        {
+            close(fd);
+            return false;
+        }
+        void* addr = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED)
+            return false;
+        entry.data = static_cast<const uint8_t*>(addr);
+        entry.length = length;
+#else
+        std::ifstream ifs(file, std::ifstream::binary);
+        if (!ifs.is_open())
+            return false;
+        entry.buffer.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        if (entry.buffer.size() != length)
+        {
+            entry.buffer.clear();
+            return false;
+        }
+        entry.data = entry.buffer.data();
+        entry.length = length;
+#endif
+        if ((memcmp(entry.data, MAGIC, sizeof(MAGIC)) != 0)
+            || (memcmp(entry.data + sizeof(MAGIC), &key, sizeof(key)) != 0))
+        {
+            // a hash collision or a stale file, generate the table again
+#ifndef _WIN32
+            munmap(const_cast<uint8_t*>(entry.data), length);
+#endif
+            entry.buffer.clear();
+            entry.data = nullptr;
+            entry.length = 0;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Write the table to file, through a temporary one.
+     */
+    static bool Store(const std::string &file, const std::vector<uint8_t> &content)
+    {
+#ifndef _WIN32
+        const std::string tmp = file + ".tmp" + std::to_string(getpid());
+#else
+        const std::string tmp = file + ".tmp";
+#endif
+        {
+            std::ofstream ofs(tmp.c_str(), std::ofstream::binary);
+            if (!ofs.is_open())
+                return false;
+            ofs.write(reinterpret_cast<const char*>(content.data()), content.size());
+            if (!ofs)
+            {
+                ofs.close();
+                std::remove(tmp.c_str());
+                return false;
+            }
+        }
+        return std::rename(tmp.c_str(), file.c_str()) == 0;
+    }
+
+    const void* Get(const Parameters &p, int wave, kind_t kind)
+    {
+        const key_t key = GetKey(p, wave, kind);
+        const std::string name = GetName(key);
+        const size_t tableSize = (kind == kind_t::ANALOG) ? 4096 * sizeof(uint16_t) : 4096;
+        const size_t length = sizeof(MAGIC) + sizeof(key) + tableSize;
+
+        std::lock_guard<std::mutex> guard(lock);
+
+        std::unique_ptr<entry_t> &entry = entries[std::string(reinterpret_cast<const char*>(&key), sizeof(key))];
+        if (entry)
+            return entry->Table();
+
+        entry.reset(new entry_t());
+        const std::string file = directory + "/" + name;
+        if (Load(file, key, length, *entry))
+            return entry->Table();
+
+        std::vector<uint8_t> content(length);
+        memcpy(content.data(), MAGIC, sizeof(MAGIC));
+        memcpy(content.data() + sizeof(MAGIC), &key, sizeof(key));
+        uint8_t* table = content.data() + sizeof(MAGIC) + sizeof(key);
+        if (kind == kind_t::ANALOG)
+        {
+            uint16_t analog[4096];
+            p.GetAnalogTable(wave, analog);
+            memcpy(table, analog, sizeof(analog));
+        }
+        else
+        {
+            p.GetTable(wave, table);
+        }
+
+        if (!Store(file, content) || !Load(file, key, length, *entry))
+        {
+            entry->buffer = std::move(content);
+            entry->data = entry->buffer.data();
+            entry->length = length;
+        }
+        return entry->Table();
+    }
+
+public:
+    /**
+     * @param directory where the tables are kept, it must exist
+     */
+    explicit TableCache(const char* directory) :
+        directory(directory)
+    {}
+
+    TableCache(const TableCache&) = delete;
+    TableCache& operator=(const TableCache&) = delete;
+
+    /**
+     * Get the predicted upper 8 bits for all the 4096 oscillator values,
+     * as Parameters::GetTable().
+     */
+    const uint8_t* GetTable(const Parameters &p, int wave)
+    {
+        return static_cast<const uint8_t*>(Get(p, wave, kind_t::DIGITAL));
+    }
+
+    /**
+     * Get the predicted 12 bit analog values for all the 4096 oscillator values,
+     * as Parameters::GetAnalogTable().
+     */
+    const uint16_t* GetAnalogTable(const Parameters &p, int wave)
+    {
+        return static_cast<const uint16_t*>(Get(p, wave, kind_t::ANALOG));
+    }
+
+    /**
+     * Fill the tables of all the waveforms, the analog ones too if used,
+     * with the same content of the tables_t generated from the parameters.
+     */
+    void GetTables(const Parameters params[tables_t::WAVES], tables_t &tables)
+    {
+        for (unsigned int w = 0; w < tables_t::WAVES; w++)
+        {
+            memcpy(tables.digital[w], GetTable(params[w], tables_t::wave[w]), sizeof(tables.digital[w]));
+            if (tables.hasAnalog)
+                memcpy(tables.analog[w], GetAnalogTable(params[w], tables_t::wave[w]), sizeof(tables.analog[w]));
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,72 @@
+/*
+ * This file is part of libsidplayfp, a SID player engine.
+ *
+ * Copyright 2026 Leandro Nini <drfiemost@users.sourceforge.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef TABLES_H
+#define TABLES_H
+
+#include "parameters.h"
+
+#include <cstdint>
+
+/**
+ * Combined waveform tables generated from the model parameters,
+ * one for each of the waveforms 3, 5, 6 and 7.
+ */
+struct tables_t
+{
+    static constexpr unsigned int WAVES = 4;
+    static constexpr int wave[WAVES] = { 3, 5, 6, 7 };
+
+    /// upper 8 bits of the output
+    uint8_t digital[WAVES][4096];
+
+    /// 12 bit analog output, optional
+    uint16_t analog[WAVES][4096];
+
+    bool hasAnalog;
+
+    /**
+     * Generate the tables.
+     *
+     * @param params the parameters for each waveform
+     * @param withAnalog generate also the analog tables
+     */
+    tables_t(const Parameters params[WAVES], bool withAnalog) :
+        hasAnalog(withAnalog)
+    {
+        for (unsigned int w = 0; w < WAVES; w++)
+        {
+            params[w].GetTable(wave[w], digital[w]);
+            if (hasAnalog)
+                params[w].GetAnalogTable(wave[w], analog[w]);
+        }
+    }
+
+    /**
+     * Leave the tables to be filled by the caller.
+     *
+     * @param withAnalog whether the analog tables are used
+     */
+    explicit tables_t(bool withAnalog) :
+        hasAnalog(withAnalog)
+    {}
+};
+
+#endif